@@ -13,6 +13,8 @@
 #include <linux/slab.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
 
 #include "zcomp.h"
 #include "zcomp_lzo.h"
@@ -43,6 +45,16 @@ struct zcomp_strm_multi {
 	wait_queue_head_t strm_wait;
 };
 
+/*
+ * per-cpu zcomp_strm backend: one stream per online cpu, used with
+ * preemption disabled, so finding a stream never locks or sleeps
+ */
+struct zcomp_strm_percpu {
+	struct zcomp *comp;
+	struct zcomp_strm * __percpu *strm;
+	struct notifier_block notifier;
+};
+
 static struct zcomp_backend *backends[] = {
 	&zcomp_lzo,
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
@@ -158,6 +170,10 @@ static bool zcomp_strm_multi_set_max_streams(struct zcomp *comp, int num_strm)
 	struct zcomp_strm_multi *zs = comp->stream;
 	struct zcomp_strm *zstrm;
 
+	/* switching to per-cpu streams needs a new zcomp */
+	if (num_strm < 1)
+		return false;
+
 	spin_lock(&zs->strm_lock);
 	zs->max_strm = num_strm;
 	/*
@@ -267,6 +283,120 @@ static int zcomp_strm_single_create(struct zcomp *comp)
 	return 0;
 }
 
+static struct zcomp_strm *zcomp_strm_percpu_find(struct zcomp *comp)
+{
+	struct zcomp_strm_percpu *zs = comp->stream;
+
+	return *get_cpu_ptr(zs->strm);
+}
+
+static void zcomp_strm_percpu_release(struct zcomp *comp,
+		struct zcomp_strm *zstrm)
+{
+	struct zcomp_strm_percpu *zs = comp->stream;
+
+	put_cpu_ptr(zs->strm);
+}
+
+static bool zcomp_strm_percpu_set_max_streams(struct zcomp *comp, int num_strm)
+{
+	/* zcomp_strm_percpu follows the online cpus, max_comp_streams == 0 */
+	return num_strm == 0;
+}
+
+static int zcomp_strm_percpu_notify(struct notifier_block *nb,
+		unsigned long action, void *pcpu)
+{
+	struct zcomp_strm_percpu *zs = container_of(nb,
+			struct zcomp_strm_percpu, notifier);
+	struct zcomp_strm **pstrm;
+	int cpu = (long)pcpu;
+
+	pstrm = per_cpu_ptr(zs->strm, cpu);
+	switch (action) {
+	case CPU_UP_PREPARE:
+		if (*pstrm)
+			break;
+		*pstrm = zcomp_strm_alloc(zs->comp);
+		if (!*pstrm)
+			return notifier_from_errno(-ENOMEM);
+		break;
+	case CPU_DEAD:
+	case CPU_UP_CANCELED:
+		if (*pstrm) {
+			zcomp_strm_free(zs->comp, *pstrm);
+			*pstrm = NULL;
+		}
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static void zcomp_strm_percpu_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm_percpu *zs = comp->stream;
+	int cpu;
+
+	unregister_cpu_notifier(&zs->notifier);
+	for_each_possible_cpu(cpu)
+		zcomp_strm_percpu_notify(&zs->notifier, CPU_DEAD,
+				(void *)(long)cpu);
+	free_percpu(zs->strm);
+	kfree(zs);
+}
+
+static int zcomp_strm_percpu_create(struct zcomp *comp)
+{
+	struct zcomp_strm_percpu *zs;
+	int cpu, ret = NOTIFY_OK;
+
+	comp->destroy = zcomp_strm_percpu_destroy;
+	comp->strm_find = zcomp_strm_percpu_find;
+	comp->strm_release = zcomp_strm_percpu_release;
+	comp->set_max_streams = zcomp_strm_percpu_set_max_streams;
+	zs = kzalloc(sizeof(struct zcomp_strm_percpu), GFP_KERNEL);
+	if (!zs)
+		return -ENOMEM;
+
+	zs->strm = alloc_percpu(struct zcomp_strm *);
+	if (!zs->strm) {
+		kfree(zs);
+		return -ENOMEM;
+	}
+	zs->comp = comp;
+	zs->notifier.notifier_call = zcomp_strm_percpu_notify;
+
+	/*
+	 * register first, so a cpu coming up meanwhile gets its stream;
+	 * CPU_UP_PREPARE leaves an existing stream alone. The online cpus
+	 * are walked with hotplug held off, so a CPU_DEAD cannot free a
+	 * stream under us. register_cpu_notifier() must not be called
+	 * inside get_online_cpus(): it would wait on cpu_maps_update_begin()
+	 * while a cpu_down() holding it waits for our reference.
+	 */
+	register_cpu_notifier(&zs->notifier);
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		ret = zcomp_strm_percpu_notify(&zs->notifier, CPU_UP_PREPARE,
+				(void *)(long)cpu);
+		if (notifier_to_errno(ret))
+			break;
+	}
+	put_online_cpus();
+
+	if (notifier_to_errno(ret)) {
+		unregister_cpu_notifier(&zs->notifier);
+		for_each_possible_cpu(cpu)
+			zcomp_strm_percpu_notify(&zs->notifier, CPU_DEAD,
+					(void *)(long)cpu);
+		free_percpu(zs->strm);
+		kfree(zs);
+		return -ENOMEM;
+	}
+	comp->stream = zs;
+	return 0;
+}
+
 /* show available compressors */
 ssize_t zcomp_available_show(const char *comp, char *buf)
 {
@@ -322,7 +452,8 @@ void zcomp_destroy(struct zcomp *comp)
 
 /*
  * search available compressors for requested algorithm.
- * allocate new zcomp and initialize it. return compressing
+ * allocate new zcomp and initialize it with max_strm streams, or
+ * one stream per online cpu if max_strm is 0. return compressing
  * backend pointer or ERR_PTR if things went bad. ERR_PTR(-EINVAL)
  * if requested algorithm is not supported, ERR_PTR(-ENOMEM) in
  * case of allocation error.
@@ -341,7 +472,9 @@ struct zcomp *zcomp_create(const char *compress, int max_strm)
 		return ERR_PTR(-ENOMEM);
 
 	comp->backend = backend;
-	if (max_strm > 1)
+	if (max_strm == 0)
+		zcomp_strm_percpu_create(comp);
+	else if (max_strm > 1)
 		zcomp_strm_multi_create(comp, max_strm);
 	else
 		zcomp_strm_single_create(comp);
@@ -0,0 +1,162 @@
+/*
+ * Deduplication of identical pages stored in zram
+ *
+ * Every stored object is indexed by a checksum of its uncompressed page
+ * in a hash of rb trees. A page whose checksum matches an object and
+ * whose contents match it in full takes a reference on that object
+ * instead of being compressed and stored again.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/rbtree.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* one bucket per ZRAM_HASH_PAGES pages of disksize */
+#define ZRAM_HASH_PAGES		16
+#define ZRAM_HASH_SIZE_MIN	(1 << 10)
+#define ZRAM_HASH_SIZE_MAX	(1 << 16)
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash(mem, PAGE_SIZE, 0);
+}
+
+static struct zram_hash *zram_dedup_hash(struct zram_meta *meta, u32 checksum)
+{
+	return &meta->hash[checksum % meta->hash_size];
+}
+
+void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
+		u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry;
+
+	new->checksum = checksum;
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		entry = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < entry->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+	rb_link_node(&new->rb_node, parent, rb_node);
+	rb_insert_color(&new->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+}
+
+/* Does entry hold the page at mem? zstrm->buffer is free to use. */
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+		unsigned char *mem, struct zcomp_strm *zstrm)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned char *cmem;
+	bool match;
+
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE)
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	else
+		match = !zcomp_decompress(zram_entry_comp(zram, entry),
+					  cmem, entry->len,
+					  zstrm->buffer) &&
+			!memcmp(mem, zstrm->buffer, PAGE_SIZE);
+	zs_unmap_object(meta->mem_pool, entry->handle);
+	return match;
+}
+
+/*
+ * Find a stored object holding the same page as mem and take a reference
+ * on it, or return NULL. Objects with the same checksum sit next to each
+ * other in the tree, and each is compared in turn under the bucket lock,
+ * so none can be freed meanwhile.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+		struct zcomp_strm *zstrm, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct zram_entry *entry = NULL;
+	struct rb_node *rb_node, *prev;
+
+	spin_lock(&hash->lock);
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+		rb_node = checksum < entry->checksum ?
+			rb_node->rb_left : rb_node->rb_right;
+	}
+	/* back to the first object with this checksum */
+	while (rb_node && (prev = rb_prev(rb_node)) &&
+	       rb_entry(prev, struct zram_entry, rb_node)->checksum == checksum)
+		rb_node = prev;
+
+	for (; rb_node; rb_node = rb_next(rb_node)) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+		if (zram_dedup_match(zram, entry, mem, zstrm)) {
+			entry->refcount++;
+			spin_unlock(&hash->lock);
+			return entry;
+		}
+	}
+	spin_unlock(&hash->lock);
+	return NULL;
+}
+
+/*
+ * Drop a reference to entry, taking it out of the tree with the last one.
+ * Returns true if the caller must free it.
+ */
+bool zram_dedup_put_entry(struct zram_meta *meta, struct zram_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_hash(meta, entry->checksum);
+	unsigned long refcount;
+
+	spin_lock(&hash->lock);
+	refcount = --entry->refcount;
+	if (!refcount && !RB_EMPTY_NODE(&entry->rb_node)) {
+		rb_erase(&entry->rb_node, &hash->rb_root);
+		RB_CLEAR_NODE(&entry->rb_node);
+	}
+	spin_unlock(&hash->lock);
+
+	return !refcount;
+}
+
+int zram_dedup_init(struct zram_meta *meta, size_t num_pages)
+{
+	size_t i;
+
+	meta->hash_size = clamp_t(size_t, num_pages / ZRAM_HASH_PAGES,
+				  ZRAM_HASH_SIZE_MIN, ZRAM_HASH_SIZE_MAX);
+	meta->hash = vzalloc(meta->hash_size * sizeof(struct zram_hash));
+	if (!meta->hash)
+		return -ENOMEM;
+
+	for (i = 0; i < meta->hash_size; i++) {
+		spin_lock_init(&meta->hash[i].lock);
+		meta->hash[i].rb_root = RB_ROOT;
+	}
+	return 0;
+}
+
+void zram_dedup_fini(struct zram_meta *meta)
+{
+	vfree(meta->hash);
+	meta->hash = NULL;
+}
@@ -32,12 +32,19 @@
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/err.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
 /* Globals */
 static int zram_major;
 static struct zram *zram_devices;
+static struct workqueue_struct *zram_wq;
 static const char *default_compressor = "lzo";
 
 /* Module params (documentation at end) */
@@ -93,6 +100,26 @@ static ssize_t compact_store(struct device *dev,
 	return len;
 }
 
+/*
+ * Pages freed by compaction of the pool, whether asked for through
+ * compact or done in the background by zsmalloc, and the time it took.
+ */
+static ssize_t compact_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zs_pool_stats pool_stats = { 0 };
+
+	down_read(&zram->init_lock);
+	if (init_done(zram))
+		zs_pool_stats(zram->meta->mem_pool, &pool_stats);
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%lu %llu\n",
+			 pool_stats.pages_compacted,
+			 div_u64(pool_stats.compact_ns, NSEC_PER_MSEC));
+}
+
 static ssize_t disksize_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -229,12 +256,15 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	ret = kstrtoint(buf, 0, &num);
 	if (ret < 0)
 		return ret;
-	if (num < 1)
+	/* 0 asks for one stream per online cpu */
+	if (num < 0)
 		return -EINVAL;
 
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
-		if (!zcomp_set_max_streams(zram->comp, num)) {
+		if (!zcomp_set_max_streams(zram->comp, num) ||
+		    (zram->fallback &&
+		     !zcomp_set_max_streams(zram->fallback, num))) {
 			pr_info("Cannot change max compression streams\n");
 			ret = -EINVAL;
 			goto out;
@@ -248,6 +278,62 @@ out:
 	return ret;
 }
 
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)zram->async_write);
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	zram->async_write = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+
 static ssize_t comp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -276,6 +362,130 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t fallback_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = scnprintf(buf, PAGE_SIZE, zram->fallback_compressor[0] ?
+		       "none " : "[none] ");
+	sz += zcomp_available_show(zram->fallback_compressor, buf + sz);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t fallback_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	if (sysfs_streq(buf, "none"))
+		zram->fallback_compressor[0] = '\0';
+	else
+		strlcpy(zram->fallback_compressor, buf,
+			sizeof(zram->fallback_compressor));
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t fallback_threshold_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%zu\n", zram->fallback_threshold);
+}
+
+static ssize_t fallback_threshold_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (val >= PAGE_SIZE)
+		return -EINVAL;
+
+	zram->fallback_threshold = val;
+	return len;
+}
+
+static ssize_t zram_hist_show(char *buf, size_t size, const char *name,
+		const char *what, atomic64_t *hist, int nr)
+{
+	ssize_t sz;
+	int i;
+
+	sz = scnprintf(buf, size, "%s %s", name, what);
+	for (i = 0; i < nr; i++)
+		sz += scnprintf(buf + sz, size - sz, " %llu",
+				(u64)atomic64_read(&hist[i]));
+	sz += scnprintf(buf + sz, size - sz, "\n");
+	return sz;
+}
+
+/*
+ * One line per compressor and histogram: compression and decompression
+ * latencies, then compressed sizes. Buckets are described in zram_drv.h.
+ */
+static ssize_t comp_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_comp_stats *stats;
+	const char *name;
+	ssize_t sz = 0;
+	int i;
+
+	down_read(&zram->init_lock);
+	for (i = 0; i < ZRAM_NR_COMPS; i++) {
+		name = i == ZRAM_COMP_FALLBACK ? zram->fallback_compressor :
+						 zram->compressor;
+		if (!name[0])
+			continue;
+
+		stats = &zram->stats.comp[i];
+		sz += zram_hist_show(buf + sz, PAGE_SIZE - sz, name,
+				     "comp_ns", stats->comp_ns,
+				     ZRAM_LAT_BUCKETS);
+		sz += zram_hist_show(buf + sz, PAGE_SIZE - sz, name,
+				     "decomp_ns", stats->decomp_ns,
+				     ZRAM_LAT_BUCKETS);
+		sz += zram_hist_show(buf + sz, PAGE_SIZE - sz, name,
+				     "size", stats->size, ZRAM_SIZE_BUCKETS);
+	}
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static void zram_account_lat(atomic64_t *hist, u64 ns)
+{
+	int i = 0;
+
+	if (ns >> 9)
+		i = min_t(int, ilog2(ns) - 8, ZRAM_LAT_BUCKETS - 1);
+	atomic64_inc(&hist[i]);
+}
+
+static void zram_account_size(struct zram_comp_stats *stats, size_t clen)
+{
+	int i = clen ? (clen - 1) * ZRAM_SIZE_BUCKETS / PAGE_SIZE : 0;
+
+	atomic64_inc(&stats->size[min_t(int, i, ZRAM_SIZE_BUCKETS - 1)]);
+}
+
 /* flag operations needs meta->tb_lock */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
@@ -337,6 +547,38 @@ static inline int valid_io_request(struct zram *zram,
 	return 1;
 }
 
+static struct zram_entry *zram_entry_alloc(struct zram_meta *meta,
+		size_t len, gfp_t gfp)
+{
+	struct zram_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), gfp & ~__GFP_HIGHMEM);
+	if (!entry)
+		return NULL;
+
+	entry->handle = zs_malloc_gfp(meta->mem_pool, len, gfp);
+	if (!entry->handle) {
+		kfree(entry);
+		return NULL;
+	}
+	RB_CLEAR_NODE(&entry->rb_node);
+	entry->len = len;
+	entry->comp = ZRAM_COMP_PRIMARY;
+	entry->refcount = 1;
+	return entry;
+}
+
+/* Drop a reference to entry. Returns true if that freed it. */
+static bool zram_entry_put(struct zram_meta *meta, struct zram_entry *entry)
+{
+	if (meta->hash && !zram_dedup_put_entry(meta, entry))
+		return false;
+
+	zs_free(meta->mem_pool, entry->handle);
+	kfree(entry);
+	return true;
+}
+
 static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 {
 	size_t num_pages = disksize >> PAGE_SHIFT;
@@ -344,24 +586,27 @@ static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < num_pages; index++) {
-		unsigned long handle = meta->table[index].handle;
+		struct zram_entry *entry = meta->table[index].entry;
 
-		if (!handle)
+		if (!entry || zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		zram_entry_put(meta, entry);
 	}
 
 	zs_destroy_pool(meta->mem_pool);
+	zram_dedup_fini(meta);
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(int device_id, u64 disksize)
+static struct zram_meta *zram_meta_alloc(int device_id, u64 disksize,
+		bool use_dedup)
 {
 	size_t num_pages;
 	char pool_name[8];
-	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
+	struct zram_meta *meta = kzalloc(sizeof(*meta), GFP_KERNEL);
 
 	if (!meta)
 		return NULL;
@@ -380,8 +625,15 @@ static struct zram_meta *zram_meta_alloc(int device_id, u64 disksize)
 		goto out_error;
 	}
 
+	if (use_dedup && zram_dedup_init(meta, num_pages)) {
+		pr_err("Error allocating zram dedup hash\n");
+		goto out_destroy_pool;
+	}
+
 	return meta;
 
+out_destroy_pool:
+	zs_destroy_pool(meta->mem_pool);
 out_error:
 	vfree(meta->table);
 	kfree(meta);
@@ -397,9 +649,225 @@ static inline bool zram_meta_get(struct zram *zram)
 
 static inline void zram_meta_put(struct zram *zram)
 {
-	atomic_dec(&zram->refcount);
+	if (atomic_dec_and_test(&zram->refcount))
+		wake_up(&zram->io_done);
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *file;
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	file = zram->backing_dev;
+	if (!file) {
+		ret = scnprintf(buf, PAGE_SIZE, "none\n");
+		goto out;
+	}
+
+	p = d_path(&file->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
 }
 
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *backing_dev = NULL;
+	struct block_device *bdev = NULL;
+	unsigned long nr_pages, *bitmap = NULL;
+	struct inode *inode;
+	char *file_name;
+	size_t sz;
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = '\0';
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	/* a file can be set up through a loop device */
+	inode = backing_dev->f_mapping->host;
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	reset_bdev(zram);
+	zram->backing_dev = backing_dev;
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+	return len;
+out:
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+	return err;
+}
+
+/* block 0 is never handed out */
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+
+	do {
+		blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages,
+					     blk_idx);
+		if (blk_idx >= zram->nr_pages)
+			return 0;
+	} while (test_and_set_bit(blk_idx, zram->bitmap));
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	WARN_ON_ONCE(!test_and_clear_bit(blk_idx, zram->bitmap));
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+/* Read or write one page at blk_idx of the backing device and wait. */
+static int zram_bdev_rw(struct zram *zram, struct page *page,
+		unsigned long blk_idx, int rw)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk_idx << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+	if (!ret)
+		atomic64_inc(rw == READ ? &zram->stats.bd_reads :
+			     &zram->stats.bd_writes);
+	return ret;
+}
+
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long blk_idx;
+	struct page *page;
+	int ret;
+};
+
+static void zram_sync_read(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+
+	zw->ret = zram_bdev_rw(zw->zram, zw->page, zw->blk_idx, READ);
+}
+
+/*
+ * A bio submitted from within zram's make_request_fn is only queued on
+ * current->bio_list until that returns, so waiting for it there would
+ * never end. Such reads are handed to a worker.
+ */
+static int read_from_bdev(struct zram *zram, struct page *page,
+		unsigned long blk_idx)
+{
+	struct zram_work work;
+
+	if (!current->bio_list)
+		return zram_bdev_rw(zram, page, blk_idx, READ);
+
+	work.zram = zram;
+	work.page = page;
+	work.blk_idx = blk_idx;
+	INIT_WORK_ONSTACK(&work.work, zram_sync_read);
+	queue_work(zram_wq, &work.work);
+	flush_work(&work.work);
+	destroy_work_on_stack(&work.work);
+	return work.ret;
+}
+#else
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram, unsigned long blk_idx) {}
+static inline int read_from_bdev(struct zram *zram, struct page *page,
+		unsigned long blk_idx)
+{
+	return -EIO;
+}
+#endif
+
 static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 {
 	if (*offset + bvec->bv_len >= PAGE_SIZE)
@@ -407,31 +875,64 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Is the page one word repeated? Eight words are folded into one test per
+ * iteration, which keeps the loop free of branches between loads; a mixed
+ * page is usually rejected in the first iteration.
+ */
+static bool page_same_filled(void *ptr, unsigned long *element)
 {
+	unsigned long *page = ptr;
+	unsigned long val = page[0];
 	unsigned int pos;
-	unsigned long *page;
 
-	page = (unsigned long *)ptr;
+	for (pos = 0; pos < PAGE_SIZE / sizeof(*page); pos += 8) {
+		if ((page[pos] ^ val) | (page[pos + 1] ^ val) |
+		    (page[pos + 2] ^ val) | (page[pos + 3] ^ val) |
+		    (page[pos + 4] ^ val) | (page[pos + 5] ^ val) |
+		    (page[pos + 6] ^ val) | (page[pos + 7] ^ val))
+			return false;
+	}
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
-			return 0;
+	*element = val;
+	return true;
+}
+
+static void zram_fill_page(void *ptr, unsigned long len,
+		unsigned long element)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	if (!element) {
+		memset(ptr, 0, len);
+		return;
 	}
 
-	return 1;
+	for (pos = 0; pos < len / sizeof(*page); pos += 4) {
+		page[pos] = element;
+		page[pos + 1] = element;
+		page[pos + 2] = element;
+		page[pos + 3] = element;
+	}
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
-	void *user_mem;
+	unsigned char *user_mem;
+	unsigned int i;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	if (is_partial_io(bvec)) {
+		/* the pattern is aligned to the start of the zram page */
+		for (i = 0; i < bvec->bv_len; i++)
+			user_mem[bvec->bv_offset + i] =
+				((unsigned char *)&element)[(bvec->bv_offset + i) %
+							    sizeof(element)];
+	} else {
+		zram_fill_page(user_mem, PAGE_SIZE, element);
+	}
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -446,63 +947,151 @@ static void handle_zero_page(struct bio_vec *bvec)
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	struct zram_entry *entry = meta->table[index].entry;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, meta->table[index].element);
+		meta->table[index].element = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		if (meta->table[index].element)
+			atomic64_dec(&zram->stats.same_pages);
+		else
 			atomic64_dec(&zram->stats.zero_pages);
-		}
+		meta->table[index].element = 0;
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
+	if (unlikely(!entry))
+		return;
 
-	atomic64_sub(zram_get_obj_size(meta, index),
-			&zram->stats.compr_data_size);
+	if (zram_entry_put(meta, entry))
+		atomic64_sub(zram_get_obj_size(meta, index),
+				&zram->stats.compr_data_size);
+	else
+		atomic64_sub(zram_get_obj_size(meta, index),
+				&zram->stats.dup_data_size);
 	atomic64_dec(&zram->stats.pages_stored);
 
-	meta->table[index].handle = 0;
+	meta->table[index].entry = NULL;
 	zram_set_obj_size(meta, index, 0);
 }
 
-static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+/* Fill mem from the slot at index, whose lock the caller holds. */
+static int __zram_decompress(struct zram *zram, char *mem, u32 index)
 {
 	int ret = 0;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle;
-	size_t size;
+	struct zram_entry *entry = meta->table[index].entry;
+	size_t size = zram_get_obj_size(meta, index);
 
-	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	handle = meta->table[index].handle;
-	size = zram_get_obj_size(meta, index);
-
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
-		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, meta->table[index].element);
+		return 0;
+	}
+	if (!entry) {
 		clear_page(mem);
 		return 0;
 	}
 
-	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
-	if (size == PAGE_SIZE)
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+	if (size == PAGE_SIZE) {
 		copy_page(mem, cmem);
-	else
-		ret = zcomp_decompress(zram->comp, cmem, size, mem);
-	zs_unmap_object(meta->mem_pool, handle);
-	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	} else {
+		u64 start = local_clock();
+
+		ret = zcomp_decompress(zram_entry_comp(zram, entry), cmem,
+				       size, mem);
+		zram_account_lat(zram->stats.comp[entry->comp].decomp_ns,
+				 local_clock() - start);
+	}
+	zs_unmap_object(meta->mem_pool, entry->handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret)) {
+	if (unlikely(ret))
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
+	return ret;
+}
+
+/*
+ * Read the page at index into page. May sleep for the backing device.
+ * The slot lock is a bit spinlock and cannot be held across that read,
+ * so the slot may be rewritten and its block freed and handed out again
+ * meanwhile. Such a read is thrown away and the slot read again.
+ */
+static int zram_read_page(struct zram *zram, struct page *page, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	void *mem;
+	int ret;
+
+retry:
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		blk_idx = meta->table[index].element;
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		ret = read_from_bdev(zram, page, blk_idx);
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_test_flag(meta, index, ZRAM_WB) ||
+		    meta->table[index].element != blk_idx) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			goto retry;
+		}
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		return ret;
 	}
 
-	return 0;
+	mem = kmap_atomic(page);
+	ret = __zram_decompress(zram, mem, index);
+	kunmap_atomic(mem);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	return ret;
+}
+
+/* Read the page at index into the buffer mem. May sleep. */
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	struct page *page;
+	void *src;
+	int ret;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	if (!zram_test_flag(meta, index, ZRAM_WB)) {
+		ret = __zram_decompress(zram, mem, index);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return ret;
+	}
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	/* the backing device is read a page at a time */
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_read_page(zram, page, index);
+	if (!ret) {
+		src = kmap_atomic(page);
+		copy_page(mem, src);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+	return ret;
 }
 
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
@@ -510,48 +1099,47 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 {
 	int ret;
 	struct page *page;
-	unsigned char *user_mem, *uncmem = NULL;
+	unsigned char *user_mem, *uncmem;
 	struct zram_meta *meta = zram->meta;
+	unsigned long element;
 	page = bvec->bv_page;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	if (zram_test_flag(meta, index, ZRAM_SAME) ||
+			(!zram_test_flag(meta, index, ZRAM_WB) &&
+			 unlikely(!meta->table[index].entry))) {
+		element = zram_test_flag(meta, index, ZRAM_SAME) ?
+			meta->table[index].element : 0;
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, element);
 		return 0;
 	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
-	if (is_partial_io(bvec))
-		/* Use  a temporary buffer to decompress the page */
-		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
-
-	user_mem = kmap_atomic(page);
-	if (!is_partial_io(bvec))
-		uncmem = user_mem;
+	if (!is_partial_io(bvec)) {
+		ret = zram_read_page(zram, page, index);
+		goto out;
+	}
 
+	/* Use  a temporary buffer to decompress the page */
+	uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
 	if (!uncmem) {
 		pr_info("Unable to allocate temp memory\n");
-		ret = -ENOMEM;
-		goto out_cleanup;
+		return -ENOMEM;
 	}
 
 	ret = zram_decompress_page(zram, uncmem, index);
-	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret))
-		goto out_cleanup;
-
-	if (is_partial_io(bvec))
+	if (!ret) {
+		user_mem = kmap_atomic(page);
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
 				bvec->bv_len);
-
-	flush_dcache_page(page);
-	ret = 0;
-out_cleanup:
-	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-		kfree(uncmem);
+		kunmap_atomic(user_mem);
+	}
+	kfree(uncmem);
+out:
+	if (!ret)
+		flush_dcache_page(page);
 	return ret;
 }
 
@@ -570,12 +1158,62 @@ static inline void update_used_max(struct zram *zram,
 	} while (old_max != cur_max);
 }
 
+/* Compress src with compressor comp_id into zstrm->buffer and account it. */
+static int zram_compress(struct zram *zram, int comp_id,
+		struct zcomp_strm *zstrm, const unsigned char *src, size_t *clen)
+{
+	struct zram_comp_stats *stats = &zram->stats.comp[comp_id];
+	struct zcomp *comp;
+	u64 start;
+	int ret;
+
+	comp = comp_id == ZRAM_COMP_FALLBACK ? zram->fallback : zram->comp;
+	start = local_clock();
+	ret = zcomp_compress(comp, zstrm, src, clen);
+	zram_account_lat(stats->comp_ns, local_clock() - start);
+	if (!ret)
+		zram_account_size(stats, *clen);
+	return ret;
+}
+
+/*
+ * The first compressor left *clen bytes in zstrm->buffer. Compress the
+ * page again with the fallback compressor and keep whichever is smaller.
+ * uncmem is the page's data for partial I/O, NULL to map page.
+ */
+static void zram_compress_fallback(struct zram *zram,
+		struct zcomp_strm *zstrm, struct page *page,
+		unsigned char *uncmem, size_t *clen, int *comp_id)
+{
+	struct zcomp_strm *fstrm;
+	unsigned char *src;
+	size_t flen;
+	int ret;
+
+	/* may sleep, so the page is not mapped yet */
+	fstrm = zcomp_strm_find(zram->fallback);
+	src = uncmem ? uncmem : kmap_atomic(page);
+	ret = zram_compress(zram, ZRAM_COMP_FALLBACK, fstrm, src, &flen);
+	if (!uncmem)
+		kunmap_atomic(src);
+
+	if (!ret && flen < *clen) {
+		memcpy(zstrm->buffer, fstrm->buffer, flen);
+		*clen = flen;
+		*comp_id = ZRAM_COMP_FALLBACK;
+	}
+	zcomp_strm_release(zram->fallback, fstrm);
+}
+
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	int comp_id;
+	u32 checksum = 0;
+	unsigned long element;
+	struct zram_entry *entry = NULL, *dup;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
@@ -599,6 +1237,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 	}
 
+compress_again:
 	zstrm = zcomp_strm_find(zram->comp);
 	locked = true;
 	user_mem = kmap_atomic(page);
@@ -612,21 +1251,49 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		if (user_mem)
 			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
-		atomic64_inc(&zram->stats.zero_pages);
+		if (element)
+			atomic64_inc(&zram->stats.same_pages);
+		else
+			atomic64_inc(&zram->stats.zero_pages);
 		ret = 0;
 		goto out;
 	}
 
-	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
+	if (meta->hash) {
+		checksum = zram_dedup_checksum(uncmem);
+		dup = zram_dedup_find(zram, uncmem, zstrm, checksum);
+		if (dup) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			zcomp_strm_release(zram->comp, zstrm);
+			locked = false;
+
+			clen = dup->len;
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_free_page(zram, index);
+			meta->table[index].entry = dup;
+			zram_set_obj_size(meta, index, clen);
+			if (clen == PAGE_SIZE)
+				zram_set_flag(meta, index, ZRAM_HUGE);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+			atomic64_add(clen, &zram->stats.dup_data_size);
+			atomic64_inc(&zram->stats.pages_stored);
+			goto out;
+		}
+	}
+
+	ret = zram_compress(zram, ZRAM_COMP_PRIMARY, zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
 		user_mem = NULL;
@@ -637,6 +1304,15 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
+	/*
+	 * Only a poorly compressed page is worth a second try: one above
+	 * max_zpage_size is stored as it is anyway.
+	 */
+	comp_id = ZRAM_COMP_PRIMARY;
+	if (zram->fallback && clen > zram->fallback_threshold &&
+	    clen <= max_zpage_size)
+		zram_compress_fallback(zram, zstrm, page, uncmem, &clen,
+				       &comp_id);
 	src = zstrm->buffer;
 	if (unlikely(clen > max_zpage_size)) {
 		clen = PAGE_SIZE;
@@ -644,8 +1320,26 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			src = uncmem;
 	}
 
-	handle = zs_malloc(meta->mem_pool, clen);
-	if (!handle) {
+	/* the page may have changed while the stream was given up below */
+	if (entry && clen != entry->len) {
+		zram_entry_put(meta, entry);
+		entry = NULL;
+	}
+	/*
+	 * A per-cpu stream is held with preemption disabled, so the pool
+	 * may not sleep to grow here. If it has to, give the stream up,
+	 * allocate with the pool's own flags and compress again.
+	 */
+	if (!entry)
+		entry = zram_entry_alloc(meta, clen,
+				GFP_NOWAIT | __GFP_HIGHMEM | __GFP_NOWARN);
+	if (!entry) {
+		zcomp_strm_release(zram->comp, zstrm);
+		locked = false;
+		entry = zram_entry_alloc(meta, clen, GFP_NOIO | __GFP_HIGHMEM);
+		if (entry)
+			goto compress_again;
+
 		pr_info("Error allocating memory for compressed page: %u, size=%zu\n",
 			index, clen);
 		ret = -ENOMEM;
@@ -654,14 +1348,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	alloced_pages = zs_get_total_pages(meta->mem_pool);
 	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
-		zs_free(meta->mem_pool, handle);
 		ret = -ENOMEM;
 		goto out;
 	}
 
 	update_used_max(zram, alloced_pages);
 
-	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
+	entry->comp = clen == PAGE_SIZE ? ZRAM_COMP_PRIMARY : comp_id;
+	cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_WO);
 
 	if ((clen == PAGE_SIZE) && !is_partial_io(bvec)) {
 		src = kmap_atomic(page);
@@ -673,7 +1367,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	zcomp_strm_release(zram->comp, zstrm);
 	locked = false;
-	zs_unmap_object(meta->mem_pool, handle);
+	zs_unmap_object(meta->mem_pool, entry->handle);
+
+	if (meta->hash)
+		zram_dedup_insert(zram, entry, checksum);
 
 	/*
 	 * Free memory associated with this sector
@@ -682,9 +1379,12 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 	zram_free_page(zram, index);
 
-	meta->table[index].handle = handle;
+	meta->table[index].entry = entry;
 	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	entry = NULL;
 
 	/* Update stats */
 	atomic64_add(clen, &zram->stats.compr_data_size);
@@ -692,11 +1392,144 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 out:
 	if (locked)
 		zcomp_strm_release(zram->comp, zstrm);
+	if (entry)
+		zram_entry_put(meta, entry);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* "all" marks every stored page idle until it is next read or written */
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index, nr_pages;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_test_flag(meta, index, ZRAM_SAME) &&
+		    !zram_test_flag(meta, index, ZRAM_WB) &&
+		    meta->table[index].entry)
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * "idle" or "huge" writes every idle or uncompressed page to the backing
+ * device and frees its memory. A page read, written or freed meanwhile
+ * stays in memory.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	unsigned long blk_idx = 0;
+	size_t index, nr_pages;
+	enum zram_pageflags mode;
+	struct page *page;
+	int ret = 0;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		if (!blk_idx) {
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB) ||
+		    zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+		    !meta->table[index].entry ||
+		    !zram_test_flag(meta, index, mode)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		if (zram_read_page(zram, page, index) ||
+		    zram_bdev_rw(zram, page, blk_idx, WRITE)) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+
+		/*
+		 * zram_free_page() clears ZRAM_UNDER_WB, and a read clears
+		 * ZRAM_IDLE: either way the copy just written is stale.
+		 */
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+		    !zram_test_flag(meta, index, mode)) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].element = blk_idx;
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		blk_idx = 0;
+	}
+
+	if (blk_idx)
+		free_block_bdev(zram, blk_idx);
+	__free_page(page);
+out_unlock:
+	up_read(&zram->init_lock);
+
+	return ret ? ret : len;
+}
+#endif
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, int rw)
 {
@@ -762,7 +1595,7 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 static void zram_reset_device(struct zram *zram)
 {
 	struct zram_meta *meta;
-	struct zcomp *comp;
+	struct zcomp *comp, *fallback;
 	u64 disksize;
 
 	down_write(&zram->init_lock);
@@ -776,6 +1609,7 @@ static void zram_reset_device(struct zram *zram)
 
 	meta = zram->meta;
 	comp = zram->comp;
+	fallback = zram->fallback;
 	disksize = zram->disksize;
 	/*
 	 * Refcount will go down to 0 eventually and r/w handler
@@ -792,20 +1626,24 @@ static void zram_reset_device(struct zram *zram)
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zram->disksize = 0;
-	zram->max_comp_streams = 1;
+	zram->fallback = NULL;
+	zram->max_comp_streams = 0;
 	set_capacity(zram->disk, 0);
+	reset_bdev(zram);
 
 	up_write(&zram->init_lock);
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(meta, disksize);
 	zcomp_destroy(comp);
+	if (fallback)
+		zcomp_destroy(fallback);
 }
 
 static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *fallback = NULL;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
@@ -815,7 +1653,8 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(zram->disk->first_minor, disksize);
+	meta = zram_meta_alloc(zram->disk->first_minor, disksize,
+			zram->use_dedup);
 	if (!meta)
 		return -ENOMEM;
 
@@ -827,17 +1666,30 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->fallback_compressor[0]) {
+		fallback = zcomp_create(zram->fallback_compressor,
+					zram->max_comp_streams);
+		if (IS_ERR(fallback)) {
+			pr_info("Cannot initialise %s compressing backend\n",
+					zram->fallback_compressor);
+			err = PTR_ERR(fallback);
+			fallback = NULL;
+			goto out_destroy_comp;
+		}
+	}
+
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		pr_info("Cannot change disksize for initialized device\n");
 		err = -EBUSY;
-		goto out_destroy_comp;
+		goto out_unlock;
 	}
 
 	init_waitqueue_head(&zram->io_done);
 	atomic_set(&zram->refcount, 1);
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->fallback = fallback;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	up_write(&zram->init_lock);
@@ -851,8 +1703,11 @@ static ssize_t disksize_store(struct device *dev,
 
 	return len;
 
-out_destroy_comp:
+out_unlock:
 	up_write(&zram->init_lock);
+out_destroy_comp:
+	if (fallback)
+		zcomp_destroy(fallback);
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta, disksize);
@@ -963,6 +1818,43 @@ out:
 /*
  * Handler function for all zram I/O requests.
  */
+/*
+ * async_write: a write bio is queued on the submitting cpu and handled by
+ * a worker bound to that cpu, along with whatever was queued meanwhile,
+ * so reclaim does not wait for compression. Each queued bio keeps its
+ * meta reference until it is done, so reset waits for the queues.
+ */
+static void zram_async_work(struct work_struct *work)
+{
+	struct zram_async *async = container_of(work, struct zram_async, work);
+	struct zram *zram = async->zram;
+	struct bio_list bios;
+	struct bio *bio;
+
+	bio_list_init(&bios);
+	spin_lock_irq(&async->lock);
+	bio_list_merge(&bios, &async->bios);
+	bio_list_init(&async->bios);
+	spin_unlock_irq(&async->lock);
+
+	while ((bio = bio_list_pop(&bios))) {
+		__zram_make_request(zram, bio);
+		zram_meta_put(zram);
+	}
+}
+
+static void zram_queue_async(struct zram *zram, struct bio *bio)
+{
+	struct zram_async *async = get_cpu_ptr(zram->async);
+	unsigned long flags;
+
+	spin_lock_irqsave(&async->lock, flags);
+	bio_list_add(&async->bios, bio);
+	spin_unlock_irqrestore(&async->lock, flags);
+	queue_work_on(smp_processor_id(), zram_wq, &async->work);
+	put_cpu_ptr(zram->async);
+}
+
 static void zram_make_request(struct request_queue *queue, struct bio *bio)
 {
 	struct zram *zram = queue->queuedata;
@@ -976,6 +1868,13 @@ static void zram_make_request(struct request_queue *queue, struct bio *bio)
 		goto put_zram;
 	}
 
+	if (zram->async_write && bio_data_dir(bio) == WRITE &&
+	    !(bio->bi_rw & REQ_DISCARD)) {
+		/* the worker drops the meta reference */
+		zram_queue_async(zram, bio);
+		return;
+	}
+
 	__zram_make_request(zram, bio);
 	zram_meta_put(zram);
 	return;
@@ -1006,6 +1905,7 @@ static const struct block_device_operations zram_devops = {
 };
 
 static DEVICE_ATTR_WO(compact);
+static DEVICE_ATTR_RO(compact_stats);
 static DEVICE_ATTR_RW(disksize);
 static DEVICE_ATTR_RO(initstate);
 static DEVICE_ATTR_WO(reset);
@@ -1015,6 +1915,19 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(use_dedup);
+static DEVICE_ATTR_RW(fallback_algorithm);
+static DEVICE_ATTR_RW(fallback_threshold);
+static DEVICE_ATTR_RO(comp_stats);
+static DEVICE_ATTR_RW(async_write);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(writeback);
+ZRAM_ATTR_RO(bd_count);
+ZRAM_ATTR_RO(bd_reads);
+ZRAM_ATTR_RO(bd_writes);
+#endif
 
 ZRAM_ATTR_RO(num_reads);
 ZRAM_ATTR_RO(num_writes);
@@ -1023,7 +1936,9 @@ ZRAM_ATTR_RO(failed_writes);
 ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
+ZRAM_ATTR_RO(same_pages);
 ZRAM_ATTR_RO(compr_data_size);
+ZRAM_ATTR_RO(dup_data_size);
 ZRAM_ATTR_RO(num_migrated);
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1036,16 +1951,32 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_failed_writes.attr,
 	&dev_attr_num_migrated.attr,
 	&dev_attr_compact.attr,
+	&dev_attr_compact_stats.attr,
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
+	&dev_attr_dup_data_size.attr,
 	&dev_attr_mem_used_total.attr,
 	&dev_attr_mem_limit.attr,
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_use_dedup.attr,
+	&dev_attr_fallback_algorithm.attr,
+	&dev_attr_fallback_threshold.attr,
+	&dev_attr_comp_stats.attr,
+	&dev_attr_async_write.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_count.attr,
+	&dev_attr_bd_reads.attr,
+	&dev_attr_bd_writes.attr,
+#endif
 	NULL,
 };
 
@@ -1056,15 +1987,27 @@ static struct attribute_group zram_disk_attr_group = {
 static int create_device(struct zram *zram, int device_id)
 {
 	struct request_queue *queue;
-	int ret = -ENOMEM;
+	struct zram_async *async;
+	int cpu, ret = -ENOMEM;
 
 	init_rwsem(&zram->init_lock);
 
+	zram->async = alloc_percpu(struct zram_async);
+	if (!zram->async)
+		goto out;
+	for_each_possible_cpu(cpu) {
+		async = per_cpu_ptr(zram->async, cpu);
+		spin_lock_init(&async->lock);
+		bio_list_init(&async->bios);
+		INIT_WORK(&async->work, zram_async_work);
+		async->zram = zram;
+	}
+
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
 		pr_err("Error allocating disk queue for device %d\n",
 			device_id);
-		goto out;
+		goto out_free_async;
 	}
 
 	blk_queue_make_request(queue, zram_make_request);
@@ -1124,8 +2067,9 @@ static int create_device(struct zram *zram, int device_id)
 		goto out_free_disk;
 	}
 	strlcpy(zram->compressor, default_compressor, sizeof(zram->compressor));
+	zram->fallback_threshold = ZRAM_FALLBACK_THRESHOLD;
 	zram->meta = NULL;
-	zram->max_comp_streams = 1;
+	zram->max_comp_streams = 0;
 	return 0;
 
 out_free_disk:
@@ -1133,6 +2077,8 @@ out_free_disk:
 	put_disk(zram->disk);
 out_free_queue:
 	blk_cleanup_queue(queue);
+out_free_async:
+	free_percpu(zram->async);
 out:
 	return ret;
 }
@@ -1156,9 +2102,11 @@ static void destroy_devices(unsigned int nr)
 		blk_cleanup_queue(zram->disk->queue);
 		del_gendisk(zram->disk);
 		put_disk(zram->disk);
+		free_percpu(zram->async);
 	}
 
 	kfree(zram_devices);
+	destroy_workqueue(zram_wq);
 	unregister_blkdev(zram_major, "zram");
 	pr_info("Destroyed %u device(s)\n", nr);
 }
@@ -1173,9 +2121,15 @@ static int __init zram_init(void)
 		return -EINVAL;
 	}
 
+	/* writes may be queued from reclaim, and reads wait on it */
+	zram_wq = alloc_workqueue("zram", WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	if (!zram_wq)
+		return -ENOMEM;
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warn("Unable to get major number\n");
+		destroy_workqueue(zram_wq);
 		return -EBUSY;
 	}
 
@@ -1183,6 +2137,7 @@ static int __init zram_init(void)
 	zram_devices = kzalloc(num_devices * sizeof(struct zram), GFP_KERNEL);
 	if (!zram_devices) {
 		unregister_blkdev(zram_major, "zram");
+		destroy_workqueue(zram_wq);
 		return -ENOMEM;
 	}
 
@@ -16,9 +16,13 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/spinlock.h>
+#include <linux/rbtree.h>
+#include <linux/bio.h>
+#include <linux/workqueue.h>
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -34,6 +38,13 @@ static const unsigned max_num_devices = 32;
  */
 static const size_t max_zpage_size = PAGE_SIZE / 16 * 15;
 
+/*
+ * Pages the first compressor leaves larger than this are compressed again
+ * with fallback_algorithm, if one is set, and the smaller result is kept.
+ * Pages larger than max_zpage_size are not tried again.
+ */
+#define ZRAM_FALLBACK_THRESHOLD	(PAGE_SIZE / 2)
+
 /*
  * NOTE: max_zpage_size must be less than or equal to:
  *   ZS_MAX_ALLOC_SIZE. Otherwise, zs_malloc() would
@@ -65,21 +76,67 @@ static const size_t max_zpage_size = PAGE_SIZE / 16 * 15;
 
 /* Flags for zram pages (table[page_no].value) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
+	/* Page consists of one repeated word, kept in the table entry */
+	ZRAM_SAME = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_HUGE,	/* page is stored uncompressed */
+	ZRAM_IDLE,	/* not read or written since marked idle */
+	ZRAM_WB,	/* page is on the backing device, element is the block */
+	ZRAM_UNDER_WB,	/* being written back, cleared if the page changes */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+/*
+ * A stored object, shared by every disk page with the same contents when
+ * deduplication is on
+ */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 len;
+	u32 checksum;
+	int comp;		/* ZRAM_COMP_* it was compressed with */
+	unsigned long refcount;	/* protected by the zram_hash lock */
+	unsigned long handle;
+};
+
 /* Allocated for each disk page */
 struct zram_table_entry {
-	unsigned long handle;
+	union {
+		struct zram_entry *entry;
+		unsigned long element;	/* ZRAM_SAME, ZRAM_WB */
+	};
 	unsigned long value;
 };
 
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+enum zram_comp {
+	ZRAM_COMP_PRIMARY,	/* comp_algorithm */
+	ZRAM_COMP_FALLBACK,	/* fallback_algorithm */
+
+	ZRAM_NR_COMPS,
+};
+
+/*
+ * Bucket i of a latency histogram counts calls that took less than
+ * 2^(i + 9) ns, the last one everything slower. Bucket i of a size
+ * histogram counts pages compressed to at most (i + 1) / 8 of a page.
+ */
+#define ZRAM_LAT_BUCKETS	16
+#define ZRAM_SIZE_BUCKETS	8
+
+struct zram_comp_stats {
+	atomic64_t comp_ns[ZRAM_LAT_BUCKETS];
+	atomic64_t decomp_ns[ZRAM_LAT_BUCKETS];
+	atomic64_t size[ZRAM_SIZE_BUCKETS];
+};
+
 struct zram_stats {
 	atomic64_t compr_data_size;	/* compressed size of pages stored */
 	atomic64_t num_reads;	/* failed + successful */
@@ -90,18 +147,38 @@ struct zram_stats {
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
 	atomic64_t zero_pages;		/* no. of zero filled pages */
+	atomic64_t same_pages;		/* no. of other same filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
+	atomic64_t dup_data_size;	/* compressed size of pages
+					   stored as duplicates */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
+	struct zram_comp_stats comp[ZRAM_NR_COMPS];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages on the backing device */
+	atomic64_t bd_reads;		/* no. of reads from the backing device */
+	atomic64_t bd_writes;		/* no. of writes to the backing device */
+#endif
 };
 
 struct zram_meta {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
+	struct zram_hash *hash;		/* NULL unless use_dedup */
+	size_t hash_size;
+};
+
+/* per-cpu queue of write bios for async_write */
+struct zram_async {
+	spinlock_t lock;
+	struct bio_list bios;
+	struct work_struct work;
+	struct zram *zram;
 };
 
 struct zram {
 	struct zram_meta *meta;
 	struct zcomp *comp;
+	struct zcomp *fallback;		/* NULL unless fallback_algorithm */
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -110,6 +187,9 @@ struct zram {
 	 */
 	unsigned long limit_pages;
 	int max_comp_streams;
+	bool use_dedup;
+	bool async_write;
+	struct zram_async __percpu *async;
 
 	struct zram_stats stats;
 	atomic_t refcount; /* refcount for zram_meta */
@@ -121,5 +201,19 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[10];
+	char fallback_compressor[10];	/* empty for none */
+	size_t fallback_threshold;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned long nr_pages;		/* size of the backing device */
+	unsigned long *bitmap;		/* its blocks in use */
+#endif
 };
+
+static inline struct zcomp *zram_entry_comp(struct zram *zram,
+		struct zram_entry *entry)
+{
+	return entry->comp == ZRAM_COMP_FALLBACK ? zram->fallback : zram->comp;
+}
 #endif
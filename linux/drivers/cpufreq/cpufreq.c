@@ -33,6 +33,7 @@
 #include <linux/cpu.h>
 #include <linux/completion.h>
 #include <linux/mutex.h>
+#include <linux/sched.h>
 #include <linux/syscore_ops.h>
 #include <linux/suspend.h>
 #include <linux/tick.h>
@@ -1952,6 +1953,7 @@ int cpufreq_thermal_limit(int cluster, int max_freq)
 	unsigned int ret;
 	struct cpufreq_policy *policy, new_policy;
 	int cpu = 0;
+	int i;
 
 	cpu = cluster * 4;
 	policy = cpufreq_cpu_get(cpu);
@@ -1966,6 +1968,12 @@ int cpufreq_thermal_limit(int cluster, int max_freq)
 	ret = __cpufreq_set_policy(policy, &new_policy);
 	policy->user_policy.max = policy->max;
 
+	/* let the WRR class steer work away from the throttled cluster */
+	if (!ret && policy->cpuinfo.max_freq)
+		for_each_cpu(i, policy->related_cpus)
+			sched_wrr_set_capacity(i, policy->max *
+				SCHED_POWER_SCALE / policy->cpuinfo.max_freq);
+
 	return ret;
 
 }
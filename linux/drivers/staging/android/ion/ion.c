@@ -30,16 +30,21 @@
 #include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 #include <linux/debugfs.h>
 #include <linux/dma-buf.h>
 #include <linux/idr.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 
 #include "ion.h"
 #include "ion_priv.h"
 #include "compat_ion.h"
+#include "ion_trace.h"
 
 /**
  * struct ion_device - the metadata of the ion device node
@@ -277,6 +282,7 @@ err2:
 
 void ion_buffer_destroy(struct ion_buffer *buffer)
 {
+	trace_ion_free_buffer(buffer);
 	if (WARN_ON(buffer->kmap_cnt > 0))
 		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
 	buffer->heap->ops->unmap_dma(buffer->heap, buffer);
@@ -489,6 +495,35 @@ static int ion_handle_add(struct ion_client *client, struct ion_handle *handle)
 	return 0;
 }
 
+static void ion_heap_account_alloc(struct ion_heap *heap, size_t len,
+				   unsigned int flags, ktime_t start,
+				   struct ion_buffer *buffer)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 slices = div_u64(ns, 16 * NSEC_PER_USEC);
+	int size_class, lat = 0;
+
+	trace_ion_alloc_buffer(heap->name, len, flags, ns,
+			       IS_ERR(buffer) ? PTR_ERR(buffer) : 0);
+	if (IS_ERR(buffer)) {
+		atomic_inc(&heap->stats.alloc_fail);
+		return;
+	}
+
+	if (len <= SZ_64K)
+		size_class = 0;
+	else if (len <= SZ_1M)
+		size_class = 1;
+	else if (len <= SZ_16M)
+		size_class = 2;
+	else
+		size_class = 3;
+	if (slices)
+		lat = min_t(int, ilog2(slices) + 1, ION_LAT_BUCKETS - 1);
+	atomic_inc(&heap->stats.alloc_lat[size_class][lat]);
+	atomic64_add(ns, &heap->stats.alloc_ns);
+}
+
 struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 			     size_t align, unsigned int heap_id_mask,
 			     unsigned int flags)
@@ -497,6 +532,7 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	struct ion_device *dev = client->dev;
 	struct ion_buffer *buffer = NULL;
 	struct ion_heap *heap;
+	ktime_t start;
 	int ret;
 
 	pr_debug("%s: len %zu align %zu heap_id_mask %u flags %x\n", __func__,
@@ -517,7 +553,9 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 		/* if the caller didn't specify this heap id */
 		if (!((1 << heap->id) & heap_id_mask))
 			continue;
+		start = ktime_get();
 		buffer = ion_buffer_create(heap, dev, len, align, flags);
+		ion_heap_account_alloc(heap, len, flags, start, buffer);
 		if (!IS_ERR(buffer))
 			break;
 	}
@@ -653,6 +691,7 @@ static void *ion_buffer_kmap_get(struct ion_buffer *buffer)
 		buffer->kmap_cnt++;
 		return buffer->vaddr;
 	}
+	trace_ion_map_kernel(buffer);
 	vaddr = buffer->heap->ops->map_kernel(buffer->heap, buffer);
 	if (WARN_ONCE(vaddr == NULL,
 			"heap->ops->map_kernel should return ERR_PTR on error"))
@@ -1047,6 +1086,7 @@ void ion_pages_sync_for_device(struct device *dev, struct page *page,
 		size_t size, enum dma_data_direction dir)
 {
 	struct scatterlist sg;
+	ktime_t start = ktime_get();
 
 	sg_init_table(&sg, 1);
 	sg_set_page(&sg, page, size, 0);
@@ -1057,6 +1097,8 @@ void ion_pages_sync_for_device(struct device *dev, struct page *page,
 	 */
 	sg_dma_address(&sg) = page_to_phys(page);
 	dma_sync_sg_for_device(dev, &sg, 1, dir);
+	trace_ion_sync_for_device(size, dir,
+				  ktime_to_ns(ktime_sub(ktime_get(), start)));
 }
 
 struct ion_vma_list {
@@ -1178,6 +1220,7 @@ static int ion_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
 	if (!(buffer->flags & ION_FLAG_CACHED))
 		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
+	trace_ion_map_user(buffer);
 	mutex_lock(&buffer->lock);
 	/* now map it to userspace */
 	ret = buffer->heap->ops->map_user(buffer->heap, buffer, vma);
@@ -1597,6 +1640,36 @@ static size_t ion_debug_heap_total(struct ion_client *client,
 	return size;
 }
 #endif
+static void ion_debug_heap_stats(struct seq_file *s, struct ion_heap *heap)
+{
+	static const char * const size_classes[ION_SIZE_CLASSES] = {
+		"<=64K", "<=1M", "<=16M", ">16M",
+	};
+	int i, j;
+
+	seq_printf(s, "%16s", "alloc us");
+	for (i = 0; i < ION_LAT_BUCKETS - 1; i++)
+		seq_printf(s, " %7s%-5u", "<", 16 << i);
+	seq_printf(s, " %7s%-5u\n", ">=", 16 << (ION_LAT_BUCKETS - 2));
+
+	for (i = 0; i < ION_SIZE_CLASSES; i++) {
+		seq_printf(s, "%16s", size_classes[i]);
+		for (j = 0; j < ION_LAT_BUCKETS; j++)
+			seq_printf(s, " %12d",
+				   atomic_read(&heap->stats.alloc_lat[i][j]));
+		seq_printf(s, "\n");
+	}
+	seq_printf(s, "%16s %22d\n", "failed allocs",
+		   atomic_read(&heap->stats.alloc_fail));
+	seq_printf(s, "%16s %22llu\n", "alloc time us",
+		   div_u64(atomic64_read(&heap->stats.alloc_ns),
+			   NSEC_PER_USEC));
+	seq_printf(s, "%16s %22llu\n", "zero time us",
+		   div_u64(atomic64_read(&heap->stats.zero_ns),
+			   NSEC_PER_USEC));
+	seq_printf(s, "----------------------------------------------------------\n");
+}
+
 static int ion_debug_heap_show(struct seq_file *s, void *unused)
 {
 	struct ion_heap *heap = s->private;
@@ -1676,6 +1749,8 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 				heap->free_list_size);
 	seq_printf(s, "----------------------------------------------------------\n");
 
+	ion_debug_heap_stats(s, heap);
+
 	if (heap->debug_show)
 		heap->debug_show(heap, s, unused);
 
@@ -1873,3 +1948,6 @@ void __init ion_reserve(struct ion_platform_data *data)
 			data->heaps[i].size);
 	}
 }
+
+#define CREATE_TRACE_POINTS
+#include "ion_trace.h"
@@ -17,6 +17,7 @@
 #include <linux/err.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/rtmutex.h>
 #include <linux/sched.h>
@@ -24,6 +25,7 @@
 #include <linux/vmalloc.h>
 #include "ion.h"
 #include "ion_priv.h"
+#include "ion_trace.h"
 
 void *ion_heap_map_kernel(struct ion_heap *heap,
 			  struct ion_buffer *buffer)
@@ -139,14 +141,22 @@ static int ion_heap_sglist_zero(struct scatterlist *sgl, unsigned int nents,
 int ion_heap_buffer_zero(struct ion_buffer *buffer)
 {
 	struct sg_table *table = buffer->sg_table;
+	ktime_t start = ktime_get();
 	pgprot_t pgprot;
+	u64 ns;
+	int ret;
 
 	if (buffer->flags & ION_FLAG_CACHED)
 		pgprot = PAGE_KERNEL;
 	else
 		pgprot = pgprot_writecombine(PAGE_KERNEL);
 
-	return ion_heap_sglist_zero(table->sgl, table->nents, pgprot);
+	ret = ion_heap_sglist_zero(table->sgl, table->nents, pgprot);
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	atomic64_add(ns, &buffer->heap->stats.zero_ns);
+	trace_ion_zero_buffer(buffer, ns);
+	return ret;
 }
 
 int ion_heap_pages_zero(struct page *page, size_t size, pgprot_t pgprot)
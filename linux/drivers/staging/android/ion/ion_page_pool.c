@@ -14,14 +14,17 @@
  *
  */
 
+#include <linux/cpu.h>
 #include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
+#include <linux/ktime.h>
 #include "ion_priv.h"
 
 struct ion_page_pool_item {
@@ -29,14 +32,38 @@ struct ion_page_pool_item {
 	struct list_head list;
 };
 
-static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+/*
+ * Each cpu keeps up to ION_POOL_PCP_PAGES worth of pages of every pool in
+ * front of its lists, so buffers allocated and freed in a loop don't
+ * serialize on pool->mutex. A cache that runs empty or full moves
+ * ION_POOL_PCP_BATCH entries from or to the lists at once. Orders whose
+ * single page is bigger than the cache get none.
+ */
+#define ION_POOL_PCP_PAGES	64
+#define ION_POOL_PCP_BATCH	8
+
+/* every pool, so the caches of a cpu that goes away can be emptied */
+static LIST_HEAD(ion_page_pools);
+static DEFINE_MUTEX(ion_page_pools_lock);
+
+struct ion_page_pool_pcp {
+	int count;
+	struct page *pages[ION_POOL_PCP_PAGES];
+	struct ion_page_pool_stats stats;
+};
+
+static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool, gfp_t gfp)
 {
-	struct page *page = alloc_pages(pool->gfp_mask, pool->order);
+	struct page *page = alloc_pages(pool->gfp_mask | gfp, pool->order);
+	ktime_t start;
 
 	if (!page)
 		return NULL;
+	start = ktime_get();
 	ion_pages_sync_for_device(NULL, page, PAGE_SIZE << pool->order,
 						DMA_BIDIRECTIONAL);
+	this_cpu_add(pool->pcp->stats.sync_ns,
+		     ktime_to_ns(ktime_sub(ktime_get(), start)));
 	return page;
 }
 
@@ -46,15 +73,10 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void ion_page_pool_add_item(struct ion_page_pool *pool,
+				   struct ion_page_pool_item *item,
+				   struct page *page)
 {
-	struct ion_page_pool_item *item;
-
-	item = kmalloc(sizeof(struct ion_page_pool_item), GFP_KERNEL);
-	if (!item)
-		return -ENOMEM;
-
-	mutex_lock(&pool->mutex);
 	item->page = page;
 	if (PageHighMem(page)) {
 		list_add_tail(&item->list, &pool->high_items);
@@ -63,6 +85,18 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&item->list, &pool->low_items);
 		pool->low_count++;
 	}
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	struct ion_page_pool_item *item;
+
+	item = kmalloc(sizeof(struct ion_page_pool_item), GFP_KERNEL);
+	if (!item)
+		return -ENOMEM;
+
+	mutex_lock(&pool->mutex);
+	ion_page_pool_add_item(pool, item, page);
 	mutex_unlock(&pool->mutex);
 	return 0;
 }
@@ -90,39 +124,221 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+/*
+ * The per-cpu caches are only touched with interrupts off, by their own
+ * cpu or by ion_page_pool_drain_cpu() running there, or once their cpu is
+ * dead, so they need no lock.
+ */
+static struct page *ion_page_pool_pcp_pop(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_pcp *pcp;
+	struct page *page = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(pool->pcp);
+	if (pcp->count)
+		page = pcp->pages[--pcp->count];
+	local_irq_restore(flags);
+	return page;
+}
+
+/* Returns how many of pages[] did not fit. */
+static int ion_page_pool_pcp_push(struct ion_page_pool *pool,
+				  struct page **pages, int nr)
+{
+	struct ion_page_pool_pcp *pcp;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(pool->pcp);
+	while (nr && pcp->count < pool->pcp_max)
+		pcp->pages[pcp->count++] = pages[--nr];
+	local_irq_restore(flags);
+	return nr;
+}
+
+/* ion_page_pool_add() for up to ION_POOL_PCP_BATCH pages at once */
+static void ion_page_pool_add_batch(struct ion_page_pool *pool,
+				    struct page **pages, int nr)
+{
+	struct ion_page_pool_item *items[ION_POOL_PCP_BATCH];
+	int i;
+
+	if (!nr)
+		return;
+
+	for (i = 0; i < nr; i++) {
+		items[i] = kmalloc(sizeof(struct ion_page_pool_item),
+				   GFP_KERNEL);
+		if (!items[i])
+			ion_page_pool_free_pages(pool, pages[i]);
+	}
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < nr; i++)
+		if (items[i])
+			ion_page_pool_add_item(pool, items[i], pages[i]);
+	mutex_unlock(&pool->mutex);
+}
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool)
 {
+	struct page *batch[ION_POOL_PCP_BATCH];
 	struct page *page = NULL;
+	int nr = 0;
 
 	BUG_ON(!pool);
 
+	if (pool->pcp_max) {
+		page = ion_page_pool_pcp_pop(pool);
+		if (page) {
+			this_cpu_inc(pool->pcp->stats.hits);
+			return page;
+		}
+	}
+
 	mutex_lock(&pool->mutex);
-	if (pool->high_count)
-		page = ion_page_pool_remove(pool, true);
-	else if (pool->low_count)
-		page = ion_page_pool_remove(pool, false);
+	do {
+		if (pool->high_count)
+			page = ion_page_pool_remove(pool, true);
+		else if (pool->low_count)
+			page = ion_page_pool_remove(pool, false);
+		else
+			break;
+		batch[nr++] = page;
+	} while (nr < min(ION_POOL_PCP_BATCH, pool->pcp_max));
 	mutex_unlock(&pool->mutex);
 
-	if (!page)
-		page = ion_page_pool_alloc_pages(pool);
+	if (!nr) {
+		this_cpu_inc(pool->pcp->stats.misses);
+		return ion_page_pool_alloc_pages(pool, 0);
+	}
+	this_cpu_inc(pool->pcp->stats.hits);
 
+	/* keep the rest of the batch for the next allocations here */
+	page = batch[--nr];
+	if (nr) {
+		nr = ion_page_pool_pcp_push(pool, batch, nr);
+		ion_page_pool_add_batch(pool, batch, nr);
+	}
 	return page;
 }
 
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
-	int ret;
+	struct ion_page_pool_pcp *pcp;
+	struct page *batch[ION_POOL_PCP_BATCH];
+	unsigned long flags;
+	int nr = 0;
+
+	if (!pool->pcp_max) {
+		if (ion_page_pool_add(pool, page))
+			ion_page_pool_free_pages(pool, page);
+		return;
+	}
 
-	ret = ion_page_pool_add(pool, page);
-	if (ret)
+	/* a full cache makes room by moving its oldest pages to the lists */
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(pool->pcp);
+	if (pcp->count == pool->pcp_max) {
+		nr = min(ION_POOL_PCP_BATCH, pcp->count);
+		memcpy(batch, pcp->pages, nr * sizeof(*batch));
+		pcp->count -= nr;
+		memmove(pcp->pages, pcp->pages + nr,
+			pcp->count * sizeof(*batch));
+	}
+	pcp->pages[pcp->count++] = page;
+	local_irq_restore(flags);
+
+	ion_page_pool_add_batch(pool, batch, nr);
+}
+
+int ion_page_pool_prefill(struct ion_page_pool *pool, gfp_t gfp)
+{
+	struct page *page = ion_page_pool_alloc_pages(pool, gfp);
+
+	if (!page)
+		return -ENOMEM;
+	if (ion_page_pool_add(pool, page)) {
 		ion_page_pool_free_pages(pool, page);
+		return -ENOMEM;
+	}
+	return 0;
 }
 
+void ion_page_pool_get_stats(struct ion_page_pool *pool,
+			     struct ion_page_pool_stats *stats)
+{
+	struct ion_page_pool_stats *pcp_stats;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	for_each_possible_cpu(cpu) {
+		pcp_stats = &per_cpu_ptr(pool->pcp, cpu)->stats;
+		stats->hits += pcp_stats->hits;
+		stats->misses += pcp_stats->misses;
+		stats->sync_ns += pcp_stats->sync_ns;
+	}
+}
+
+int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	return ACCESS_ONCE(pool->high_count) + ACCESS_ONCE(pool->low_count) +
+		ion_page_pool_pcp_count(pool);
+}
+
+int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	if (!pool->pcp_max)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += per_cpu_ptr(pool->pcp, cpu)->count;
+	return count;
+}
+
+static void ion_page_pool_drain_pcp(struct ion_page_pool *pool,
+				    struct ion_page_pool_pcp *pcp)
+{
+	while (pcp->count)
+		ion_page_pool_free_pages(pool, pcp->pages[--pcp->count]);
+}
+
+static void ion_page_pool_drain_cpu(void *data)
+{
+	struct ion_page_pool *pool = data;
+
+	ion_page_pool_drain_pcp(pool, this_cpu_ptr(pool->pcp));
+}
+
+/*
+ * Give the pages in every cpu's cache back to the system. Each online cpu
+ * empties its own; the caches of a cpu are emptied by the CPU_DEAD
+ * notifier when it goes away. This runs from reclaim, so like
+ * drain_all_pages() it must not take the cpu hotplug lock: a hotplug
+ * operation allocating memory under it would deadlock here.
+ */
+static int ion_page_pool_drain(struct ion_page_pool *pool)
+{
+	int count = ion_page_pool_pcp_count(pool);
+
+	on_each_cpu(ion_page_pool_drain_cpu, pool, 1);
+	return count;
+}
+
+/*
+ * The per-cpu caches mix lowmem and highmem pages, so they only count
+ * towards, and are only drained by, reclaim that can use highmem.
+ */
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
 	int total = 0;
 
-	total += high ? (pool->high_count + pool->low_count) *
+	total += high ? (pool->high_count + pool->low_count +
+			 ion_page_pool_pcp_count(pool)) *
 		(1 << pool->order) :
 			pool->low_count * (1 << pool->order);
 	return total;
@@ -160,6 +376,10 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 		nr_freed += (1 << pool->order);
 	}
 
+	/* the lists were not enough: empty the per-cpu caches too */
+	if (i < nr_to_scan && high && pool->pcp_max)
+		nr_freed += ion_page_pool_drain(pool) * (1 << pool->order);
+
 	return nr_freed;
 }
 
@@ -178,16 +398,53 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
 
+	pool->pcp_max = ION_POOL_PCP_PAGES >> order;
+	pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (!pool->pcp) {
+		kfree(pool);
+		return NULL;
+	}
+
+	mutex_lock(&ion_page_pools_lock);
+	list_add(&pool->pools, &ion_page_pools);
+	mutex_unlock(&ion_page_pools_lock);
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	int cpu;
+
+	mutex_lock(&ion_page_pools_lock);
+	list_del(&pool->pools);
+	mutex_unlock(&ion_page_pools_lock);
+
+	for_each_possible_cpu(cpu)
+		ion_page_pool_drain_pcp(pool, per_cpu_ptr(pool->pcp, cpu));
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 
+static int ion_page_pool_cpu_notify(struct notifier_block *self,
+				    unsigned long action, void *hcpu)
+{
+	struct ion_page_pool *pool;
+	int cpu = (unsigned long)hcpu;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	/* the cpu is gone, nothing else touches its caches */
+	mutex_lock(&ion_page_pools_lock);
+	list_for_each_entry(pool, &ion_page_pools, pools)
+		ion_page_pool_drain_pcp(pool, per_cpu_ptr(pool->pcp, cpu));
+	mutex_unlock(&ion_page_pools_lock);
+	return NOTIFY_OK;
+}
+
 static int __init ion_page_pool_init(void)
 {
+	hotcpu_notifier(ion_page_pool_cpu_notify, 0);
 	return 0;
 }
 
@@ -146,6 +146,28 @@ struct ion_heap_ops {
  */
 #define ION_PRIV_FLAG_SHRINKER_FREE (1 << 0)
 
+/*
+ * Allocation latencies are kept per buffer size class: up to 64K, up to
+ * 1M, up to 16M and above 16M. Bucket i counts allocations that took less
+ * than 16us << i, the last one everything slower.
+ */
+#define ION_SIZE_CLASSES	4
+#define ION_LAT_BUCKETS		12
+
+/**
+ * struct ion_heap_stats - allocation statistics of a heap
+ * @alloc_lat:		latency histograms of buffer allocation
+ * @alloc_fail:		allocations the heap could not satisfy
+ * @alloc_ns:		total time spent allocating buffers
+ * @zero_ns:		total time spent in ion_heap_buffer_zero
+ */
+struct ion_heap_stats {
+	atomic_t alloc_lat[ION_SIZE_CLASSES][ION_LAT_BUCKETS];
+	atomic_t alloc_fail;
+	atomic64_t alloc_ns;
+	atomic64_t zero_ns;
+};
+
 /**
  * struct ion_heap - represents a heap in the system
  * @node:		rb node to put the heap on the device's tree of heaps
@@ -165,6 +187,7 @@ struct ion_heap_ops {
  * @task:		task struct of deferred free thread
  * @debug_show:		called when heap debug file is read to add any
  *			heap specific debug info to output
+ * @stats:		allocation statistics, shown in the heap debug file
  *
  * Represents a pool of memory from which buffers can be made.  In some
  * systems the only heap is regular system memory allocated via vmalloc.
@@ -186,6 +209,7 @@ struct ion_heap {
 	wait_queue_head_t waitqueue;
 	struct task_struct *task;
 	int (*debug_show)(struct ion_heap *heap, struct seq_file *, void *);
+	struct ion_heap_stats stats;
 };
 
 /**
@@ -365,6 +389,11 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @pcp:		per-cpu caches in front of the lists, used with
+ *			interrupts off instead of taking the mutex, and
+ *			per-cpu statistics
+ * @pcp_max:		pages each per-cpu cache holds, 0 for none
+ * @pools:		entry in the list of all pools, for cpu hotplug
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -380,6 +409,9 @@ struct ion_page_pool {
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	struct ion_page_pool_pcp __percpu *pcp;
+	int pcp_max;
+	struct list_head pools;
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
@@ -397,6 +429,37 @@ void ion_page_pool_free(struct ion_page_pool *, struct page *);
 int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 			  int nr_to_scan);
 
+/** ion_page_pool_pcp_count - number of pages in the per-cpu caches */
+int ion_page_pool_pcp_count(struct ion_page_pool *pool);
+
+/**
+ * struct ion_page_pool_stats - page pool statistics
+ * @hits:		allocations served from the pool
+ * @misses:		allocations that went to the page allocator
+ * @sync_ns:		time spent syncing those for the device
+ */
+struct ion_page_pool_stats {
+	unsigned long hits;
+	unsigned long misses;
+	u64 sync_ns;
+};
+
+/** ion_page_pool_get_stats - sum up the pool's per-cpu statistics */
+void ion_page_pool_get_stats(struct ion_page_pool *pool,
+			     struct ion_page_pool_stats *stats);
+
+/** ion_page_pool_count - number of pages ready in the pool, caches included */
+int ion_page_pool_count(struct ion_page_pool *pool);
+
+/** ion_page_pool_prefill - add one newly allocated page to the pool
+ * @pool:		the pool
+ * @gfp:		flags added to the pool's own for this allocation
+ *
+ * The page is allocated and synced for the device like any the pool
+ * allocates itself. Returns 0, or -ENOMEM if no page could be allocated.
+ */
+int ion_page_pool_prefill(struct ion_page_pool *pool, gfp_t gfp);
+
 /**
  * ion_pages_sync_for_device - cache flush pages for use with the specified
  *                             device
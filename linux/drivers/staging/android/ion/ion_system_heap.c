@@ -17,8 +17,12 @@
 #include <asm/page.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -46,12 +50,90 @@ static unsigned int order_to_size(int order)
 	return PAGE_SIZE << order;
 }
 
+/*
+ * The prefill thread keeps each uncached pool holding at least prefill[i]
+ * pages of order orders[i], so allocations for the frame path are a pool
+ * pop instead of a zeroing allocation, and order-8 ones don't fall back
+ * to smaller orders. Its allocations may compact memory, at idle
+ * priority, which the allocating thread's high-order ones never do.
+ * It stays off while free memory is low and for a while after the
+ * shrinker took pages from the pools.
+ */
+static int prefill[] = {2, 8, 128};
+module_param_array(prefill, int, NULL, S_IRUGO | S_IWUSR);
+
+#define ION_PREFILL_MIN_FREE	(totalram_pages / 16)
+#define ION_PREFILL_MAX		(totalram_pages / 32)	/* per pool */
+#define ION_PREFILL_BACKOFF	(5 * HZ)
+
 struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **uncached_pools;
 	struct ion_page_pool **cached_pools;
+	struct task_struct *prefill_task;
+	wait_queue_head_t prefill_wait;
+	unsigned long prefill_resume;	/* jiffies, set by the shrinker */
+	atomic_t fallbacks[ARRAY_SIZE(orders)];	/* order failed, lower used */
 };
 
+/* prefill[] is writable at runtime: read it once and keep it sane */
+static int ion_system_heap_prefill_target(int i)
+{
+	int target = ACCESS_ONCE(prefill[i]);
+
+	return clamp_t(int, target, 0, ION_PREFILL_MAX >> orders[i]);
+}
+
+static bool ion_system_heap_can_prefill(struct ion_system_heap *heap)
+{
+	return time_after_eq(jiffies, ACCESS_ONCE(heap->prefill_resume)) &&
+		global_page_state(NR_FREE_PAGES) > ION_PREFILL_MIN_FREE;
+}
+
+static bool ion_system_heap_below_prefill(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		if (ion_page_pool_count(heap->uncached_pools[i]) <
+		    ion_system_heap_prefill_target(i))
+			return true;
+	return false;
+}
+
+static int ion_system_heap_prefill(void *data)
+{
+	struct ion_system_heap *heap = data;
+	struct ion_page_pool *pool;
+	int i;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->prefill_wait,
+				     (ion_system_heap_below_prefill(heap) &&
+				      ion_system_heap_can_prefill(heap)) ||
+				     kthread_should_stop());
+
+		/* largest first: those are the ones compaction is for */
+		for (i = 0; i < num_orders; i++) {
+			pool = heap->uncached_pools[i];
+			while (ion_page_pool_count(pool) <
+			       ion_system_heap_prefill_target(i) &&
+			       ion_system_heap_can_prefill(heap) &&
+			       !kthread_should_stop()) {
+				if (ion_page_pool_prefill(pool, __GFP_WAIT)) {
+					/* fragmented: don't retry on every wakeup */
+					ACCESS_ONCE(heap->prefill_resume) =
+						jiffies + ION_PREFILL_BACKOFF;
+					break;
+				}
+				cond_resched();
+			}
+		}
+	}
+	return 0;
+}
+
 struct page_info {
 	struct page *page;
 	unsigned int order;
@@ -74,6 +156,11 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 	if (!page)
 		return NULL;
 
+	if (!cached && heap->prefill_task &&
+	    ion_page_pool_count(pool) <
+	    ion_system_heap_prefill_target(order_to_index(order)))
+		wake_up(&heap->prefill_wait);
+
 	return page;
 }
 
@@ -103,7 +190,7 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 {
 	struct page *page;
 	struct page_info *info;
-	int i;
+	int i, failed = -1;
 
 	info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
 	if (!info)
@@ -116,9 +203,14 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 			continue;
 
 		page = alloc_buffer_page(heap, buffer, orders[i]);
-		if (!page)
+		if (!page) {
+			if (failed < 0)
+				failed = i;
 			continue;
+		}
 
+		if (failed >= 0)
+			atomic_inc(&heap->fallbacks[failed]);
 		info->page = page;
 		info->order = orders[i];
 		INIT_LIST_HEAD(&info->list);
@@ -254,6 +346,7 @@ static int ion_system_heap_shrink(struct ion_heap *heap, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		goto end;
 
+	ACCESS_ONCE(sys_heap->prefill_resume) = jiffies + ION_PREFILL_BACKOFF;
 	for (i = 0; i < num_orders; i++) {
 		nr_freed += ion_page_pool_shrink(sys_heap->uncached_pools[i],
 						gfp_mask, nr_to_scan);
@@ -318,6 +411,19 @@ static struct ion_heap_ops system_heap_ops = {
 #endif
 };
 
+static void ion_system_heap_pool_stats(struct seq_file *s,
+				       struct ion_page_pool *pool,
+				       const char *name)
+{
+	struct ion_page_pool_stats stats;
+
+	ion_page_pool_get_stats(pool, &stats);
+	seq_printf(s,
+		"    order %u %8s pool: %lu hits %lu misses %llu us syncing\n",
+		pool->order, name, stats.hits, stats.misses,
+		div_u64(stats.sync_ns, NSEC_PER_USEC));
+}
+
 static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				      void *unused)
 {
@@ -328,6 +434,8 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 	int i;
 	for (i = 0; i < num_orders; i++) {
 		struct ion_page_pool *pool = sys_heap->uncached_pools[i];
+		int pcp_count = ion_page_pool_pcp_count(pool);
+
 		seq_printf(s,
 			"%3d order %u highmem pages in uncached pool = %12lu total\n",
 			pool->high_count, pool->order,
@@ -336,10 +444,17 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			"%3d order %u  lowmem pages in uncached pool = %12lu total\n",
 			pool->low_count, pool->order,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
+		seq_printf(s,
+			"%3d order %u  percpu pages in uncached pool = %12lu total\n",
+			pcp_count, pool->order,
+			(1 << pool->order) * PAGE_SIZE * pcp_count);
+		ion_system_heap_pool_stats(s, pool, "uncached");
 	}
 
 	for (i = 0; i < num_orders; i++) {
 		struct ion_page_pool *pool = sys_heap->cached_pools[i];
+		int pcp_count = ion_page_pool_pcp_count(pool);
+
 		seq_printf(s,
 			"%3d order %u highmem pages in   cached pool = %12lu total\n",
 			pool->high_count, pool->order,
@@ -348,8 +463,17 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			"%3d order %u  lowmem pages in   cached pool = %12lu total\n",
 			pool->low_count, pool->order,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
+		seq_printf(s,
+			"%3d order %u  percpu pages in   cached pool = %12lu total\n",
+			pcp_count, pool->order,
+			(1 << pool->order) * PAGE_SIZE * pcp_count);
+		ion_system_heap_pool_stats(s, pool, "cached");
 	}
 
+	for (i = 0; i < num_orders; i++)
+		seq_printf(s, "    order %u failed, fell back %d times\n",
+			   orders[i], atomic_read(&sys_heap->fallbacks[i]));
+
 	return 0;
 }
 
@@ -392,6 +516,9 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
 	struct ion_system_heap *heap;
 	int pools_size = sizeof(struct ion_page_pool *) * num_orders;
+	struct sched_param param = { .sched_priority = 0 };
+
+	BUILD_BUG_ON(ARRAY_SIZE(prefill) != ARRAY_SIZE(orders));
 
 	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
@@ -415,6 +542,18 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 		goto err_create_cached_pools;
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
+
+	/* the pools still work without it, they just start empty */
+	init_waitqueue_head(&heap->prefill_wait);
+	heap->prefill_resume = jiffies;
+	heap->prefill_task = kthread_run(ion_system_heap_prefill, heap,
+					 "ion_prefill");
+	if (IS_ERR(heap->prefill_task)) {
+		pr_err("%s: creating thread for prefill failed\n", __func__);
+		heap->prefill_task = NULL;
+	} else {
+		sched_setscheduler(heap->prefill_task, SCHED_IDLE, &param);
+	}
 	return &heap->heap;
 
 err_create_cached_pools:
@@ -434,6 +573,8 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							struct ion_system_heap,
 							heap);
 
+	if (sys_heap->prefill_task)
+		kthread_stop(sys_heap->prefill_task);
 	ion_system_heap_destroy_pools(sys_heap->uncached_pools);
 	ion_system_heap_destroy_pools(sys_heap->cached_pools);
 	kfree(sys_heap->uncached_pools);
@@ -0,0 +1,118 @@
+/*
+ * drivers/staging/android/ion/ion_trace.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ion
+
+#if !defined(_ION_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ION_TRACE_H
+
+#include <linux/tracepoint.h>
+
+struct ion_buffer;
+
+TRACE_EVENT(ion_alloc_buffer,
+	TP_PROTO(const char *heap, size_t len, unsigned int flags, u64 ns,
+		 int ret),
+	TP_ARGS(heap, len, flags, ns, ret),
+
+	TP_STRUCT__entry(
+		__string(heap, heap)
+		__field(size_t, len)
+		__field(unsigned int, flags)
+		__field(u64, ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__assign_str(heap, heap);
+		__entry->len = len;
+		__entry->flags = flags;
+		__entry->ns = ns;
+		__entry->ret = ret;
+	),
+	TP_printk("heap=%s len=%zu flags=0x%x ns=%llu ret=%d",
+		  __get_str(heap), __entry->len, __entry->flags,
+		  __entry->ns, __entry->ret)
+);
+
+DECLARE_EVENT_CLASS(ion_buffer_class,
+	TP_PROTO(struct ion_buffer *buffer),
+	TP_ARGS(buffer),
+
+	TP_STRUCT__entry(
+		__string(heap, buffer->heap->name)
+		__field(size_t, size)
+		__field(unsigned long, flags)
+	),
+	TP_fast_assign(
+		__assign_str(heap, buffer->heap->name);
+		__entry->size = buffer->size;
+		__entry->flags = buffer->flags;
+	),
+	TP_printk("heap=%s size=%zu flags=0x%lx",
+		  __get_str(heap), __entry->size, __entry->flags)
+);
+
+#define DEFINE_ION_BUFFER_EVENT(name)	\
+DEFINE_EVENT(ion_buffer_class, name,	\
+	TP_PROTO(struct ion_buffer *buffer), \
+	TP_ARGS(buffer))
+
+DEFINE_ION_BUFFER_EVENT(ion_free_buffer);
+DEFINE_ION_BUFFER_EVENT(ion_map_kernel);
+DEFINE_ION_BUFFER_EVENT(ion_map_user);
+
+TRACE_EVENT(ion_zero_buffer,
+	TP_PROTO(struct ion_buffer *buffer, u64 ns),
+	TP_ARGS(buffer, ns),
+
+	TP_STRUCT__entry(
+		__string(heap, buffer->heap->name)
+		__field(size_t, size)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__assign_str(heap, buffer->heap->name);
+		__entry->size = buffer->size;
+		__entry->ns = ns;
+	),
+	TP_printk("heap=%s size=%zu ns=%llu",
+		  __get_str(heap), __entry->size, __entry->ns)
+);
+
+TRACE_EVENT(ion_sync_for_device,
+	TP_PROTO(size_t size, int dir, u64 ns),
+	TP_ARGS(size, dir, ns),
+
+	TP_STRUCT__entry(
+		__field(size_t, size)
+		__field(int, dir)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__entry->size = size;
+		__entry->dir = dir;
+		__entry->ns = ns;
+	),
+	TP_printk("size=%zu dir=%d ns=%llu",
+		  __entry->size, __entry->dir, __entry->ns)
+);
+
+#endif /* _ION_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE ion_trace
+#include <trace/define_trace.h>
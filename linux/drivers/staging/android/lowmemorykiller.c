@@ -45,6 +45,9 @@
 #include <linux/swap.h>
 #include <linux/fs.h>
 #include <linux/sched/rt.h>
+#include <linux/rculist_nulls.h>
+#include <linux/kthread.h>
+#include <linux/vmpressure.h>
 
 #ifdef CONFIG_HIGHMEM
 #define _ZONE ZONE_HIGHMEM
@@ -80,6 +83,17 @@ static int lmk_fast_run = 1;
 static unsigned long lowmem_deathpending_timeout;
 static unsigned long oom_deathpending_timeout;
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_VMPRESSURE
+static int lowmem_vmpressure_mode = 1;
+static int lowmem_vmpressure_medium = 60;
+static int lowmem_vmpressure_critical = 95;
+static int lowmem_vmpressure_windows = 3;
+static int lowmem_vmpressure_kill_interval_ms = 100;
+#define lowmem_vmpressure_on()	ACCESS_ONCE(lowmem_vmpressure_mode)
+#else
+#define lowmem_vmpressure_on()	0
+#endif
+
 #define lowmem_print(level, x...)			\
 	do {						\
 		if (lowmem_debug_level >= (level))	\
@@ -182,6 +196,189 @@ static int test_task_flag(struct task_struct *p, int flag)
 	return 0;
 }
 
+/*
+ * Candidate index. Every thread group leader on the process list sits in
+ * the bucket of its oom_score_adj, and the scans below start at the highest
+ * non-empty bucket and stop once they are below the victim's, instead of
+ * walking every process. RSS is not kept in the index since it changes on
+ * every fault; it is read for the tasks of the buckets looked at only.
+ *
+ * Each bucket is an hlist_nulls list ending in its own bucket number, so a
+ * lockless reader standing on a task that an oom_score_adj write moves to
+ * another bucket sees the wrong end marker and starts the bucket again.
+ */
+#define LMK_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+
+static struct hlist_nulls_head lmk_buckets[LMK_BUCKETS];
+static DECLARE_BITMAP(lmk_bucket_map, LMK_BUCKETS);
+static DEFINE_SPINLOCK(lmk_index_lock);
+static bool lmk_index_ready;
+
+/* leader of the last victim until it is unhashed; compared, never used */
+static struct task_struct *lowmem_deathpending;
+
+static inline int lmk_bucket(int adj)
+{
+	return adj - OOM_SCORE_ADJ_MIN;
+}
+
+static void __lmk_index_add(struct task_struct *p, short adj)
+{
+	int b = lmk_bucket(adj);
+
+	p->lmk_adj = adj;
+	hlist_nulls_add_head_rcu(&p->lmk_node, &lmk_buckets[b]);
+	__set_bit(b, lmk_bucket_map);
+}
+
+static void __lmk_index_del(struct task_struct *p)
+{
+	int b = lmk_bucket(p->lmk_adj);
+
+	hlist_nulls_del_init_rcu(&p->lmk_node);
+	if (hlist_nulls_empty(&lmk_buckets[b]))
+		__clear_bit(b, lmk_bucket_map);
+}
+
+/* The hooks below run under tasklist_lock, except lowmem_index_update. */
+void lowmem_index_add(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_index_lock, flags);
+	if (lmk_index_ready)
+		__lmk_index_add(p, p->signal->oom_score_adj);
+	spin_unlock_irqrestore(&lmk_index_lock, flags);
+}
+
+void lowmem_index_del(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_index_lock, flags);
+	if (lmk_index_ready)
+		__lmk_index_del(p);
+	if (p == lowmem_deathpending)
+		lowmem_deathpending = NULL;
+	spin_unlock_irqrestore(&lmk_index_lock, flags);
+}
+
+/*
+ * Remember the victim's leader, unless it is already unhashed: then
+ * lowmem_index_del() has run and would never clear the pointer.
+ */
+static void lowmem_set_deathpending(struct task_struct *leader)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_index_lock, flags);
+	if (!hlist_nulls_unhashed(&leader->lmk_node))
+		lowmem_deathpending = leader;
+	spin_unlock_irqrestore(&lmk_index_lock, flags);
+}
+
+/* exec by a thread other than the leader makes that thread the leader */
+void lowmem_index_replace(struct task_struct *old, struct task_struct *new)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lmk_index_lock, flags);
+	if (lmk_index_ready) {
+		__lmk_index_del(old);
+		__lmk_index_add(new, old->lmk_adj);
+	}
+	if (old == lowmem_deathpending)
+		lowmem_deathpending = new;
+	spin_unlock_irqrestore(&lmk_index_lock, flags);
+}
+
+/*
+ * Move task's process to the bucket of its new oom_score_adj. Called after
+ * the write without task_lock or siglock held: the scans take task_lock
+ * while walking the index, and exit takes the index lock under siglock.
+ */
+void lowmem_index_update(struct task_struct *task)
+{
+	struct task_struct *leader;
+	unsigned long flags;
+	short adj;
+
+	rcu_read_lock();
+	spin_lock_irqsave(&lmk_index_lock, flags);
+	leader = task->group_leader;
+	adj = task->signal->oom_score_adj;
+	if (lmk_index_ready && !hlist_nulls_unhashed(&leader->lmk_node) &&
+	    leader->lmk_adj != adj) {
+		__lmk_index_del(leader);
+		__lmk_index_add(leader, adj);
+	}
+	spin_unlock_irqrestore(&lmk_index_lock, flags);
+	rcu_read_unlock();
+}
+
+/* Index the processes forked before the driver came up. */
+static void __init lmk_index_init(void)
+{
+	struct task_struct *p;
+	int b;
+
+	read_lock(&tasklist_lock);
+	spin_lock_irq(&lmk_index_lock);
+	for (b = 0; b < LMK_BUCKETS; b++)
+		INIT_HLIST_NULLS_HEAD(&lmk_buckets[b], b);
+	for_each_process(p)
+		__lmk_index_add(p, p->signal->oom_score_adj);
+	lmk_index_ready = true;
+	spin_unlock_irq(&lmk_index_lock);
+	read_unlock(&tasklist_lock);
+}
+
+/*
+ * First task of the highest non-empty bucket from *adj down to min_adj,
+ * with *adj set to that bucket. Called under rcu_read_lock().
+ */
+static struct task_struct *lmk_first(int *adj, int min_adj)
+{
+	struct hlist_nulls_node *n;
+
+	for (; *adj >= min_adj; (*adj)--) {
+		if (!test_bit(lmk_bucket(*adj), lmk_bucket_map))
+			continue;
+		n = rcu_dereference(hlist_nulls_first_rcu(
+				&lmk_buckets[lmk_bucket(*adj)]));
+		if (!is_a_nulls(n))
+			return hlist_nulls_entry(n, struct task_struct,
+						 lmk_node);
+	}
+	return NULL;
+}
+
+static struct task_struct *lmk_next(struct task_struct *p, int *adj,
+				    int min_adj)
+{
+	struct hlist_nulls_node *n;
+
+	n = rcu_dereference(hlist_nulls_next_rcu(&p->lmk_node));
+	if (!is_a_nulls(n))
+		return hlist_nulls_entry(n, struct task_struct, lmk_node);
+	/* on the end of another bucket, p moved: walk this one again */
+	if (get_nulls_value(n) == lmk_bucket(*adj))
+		(*adj)--;
+	return lmk_first(adj, min_adj);
+}
+
+static int lmk_top_adj(void)
+{
+	unsigned long b = find_last_bit(lmk_bucket_map, LMK_BUCKETS);
+
+	return b < LMK_BUCKETS ? b + OOM_SCORE_ADJ_MIN : OOM_SCORE_ADJ_MIN - 1;
+}
+
+/* Processes with oom_score_adj >= min_adj, highest bucket first. */
+#define for_each_lmk_candidate(p, adj, min_adj)			\
+	for (adj = lmk_top_adj(), p = lmk_first(&adj, min_adj);	\
+	     p; p = lmk_next(p, &adj, min_adj))
+
 static DEFINE_MUTEX(scan_mutex);
 
 int can_use_cma_pages(gfp_t gfp_mask)
@@ -335,6 +532,167 @@ static void boost_dying_task_prio(struct task_struct *p)
 }
 
 
+static void lowmem_other_pages(int *other_free, int *other_file)
+{
+	*other_free = global_page_state(NR_FREE_PAGES);
+	if (global_page_state(NR_SHMEM) + total_swapcache_pages() <
+		global_page_state(NR_FILE_PAGES))
+		*other_file = global_page_state(NR_FILE_PAGES) -
+						global_page_state(NR_SHMEM) -
+						total_swapcache_pages();
+	else
+		*other_file = 0;
+}
+
+static int lowmem_nr_levels(void)
+{
+	int array_size = ARRAY_SIZE(lowmem_adj);
+
+	if (lowmem_adj_size < array_size)
+		array_size = lowmem_adj_size;
+	if (lowmem_minfree_size < array_size)
+		array_size = lowmem_minfree_size;
+	return array_size;
+}
+
+/* First minfree level both counts are below, or -1. */
+static int lowmem_level(int other_free, int other_file)
+{
+	int array_size = lowmem_nr_levels();
+	int i;
+
+	for (i = 0; i < array_size; i++) {
+		if (other_free < lowmem_minfree[i] &&
+		    other_file < lowmem_minfree[i])
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Kill the process with the highest oom_score_adj at or above
+ * min_score_adj, the largest one on a tie. Returns the pages that should
+ * come back, 0 if there was nothing to kill, or -EAGAIN while the last
+ * victim is still dying. Called with scan_mutex held.
+ */
+static int lowmem_kill(short min_score_adj, int minfree, int other_free,
+		       int other_file, bool is_need_lmk_kill)
+{
+	struct task_struct *tsk;
+	struct task_struct *selected = NULL;
+	int tasksize;
+	int adj;
+	int selected_tasksize = 0;
+	short selected_oom_score_adj;
+
+#ifdef CONFIG_SEC_DEBUG_LMK_MEMINFO
+	static DEFINE_RATELIMIT_STATE(lmk_rs, DEFAULT_RATELIMIT_INTERVAL, 1);
+#endif
+
+	selected_oom_score_adj = min_score_adj;
+
+	rcu_read_lock();
+	if (ACCESS_ONCE(lowmem_deathpending) &&
+	    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		rcu_read_unlock();
+		/* give the system time to free up the memory */
+		msleep_interruptible(20);
+		return -EAGAIN;
+	}
+	for_each_lmk_candidate(tsk, adj, min_score_adj) {
+		struct task_struct *p;
+		short oom_score_adj;
+
+		/* everything left is below the victim's bucket */
+		if (selected && adj < selected_oom_score_adj)
+			break;
+
+		if (tsk->flags & PF_KTHREAD)
+			continue;
+
+		if (test_task_flag(tsk, TIF_MEMDIE)) {
+			if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+				rcu_read_unlock();
+				/* give the system time to free up the memory */
+				msleep_interruptible(20);
+				return -EAGAIN;
+			}
+			continue;
+		}
+
+		p = find_lock_task_mm(tsk);
+		if (!p)
+			continue;
+
+		oom_score_adj = p->signal->oom_score_adj;
+		if (oom_score_adj < min_score_adj) {
+			task_unlock(p);
+			continue;
+		}
+#ifdef CONFIG_ZRAM
+		tasksize = get_mm_rss(p->mm) + get_mm_counter(p->mm, MM_SWAPENTS);
+#else
+		tasksize = get_mm_rss(p->mm);
+#endif
+		task_unlock(p);
+		if (tasksize <= 0)
+			continue;
+		if (selected) {
+			if (oom_score_adj < selected_oom_score_adj)
+				continue;
+			if (oom_score_adj == selected_oom_score_adj &&
+			    tasksize <= selected_tasksize)
+				continue;
+		}
+		selected = p;
+		selected_tasksize = tasksize;
+		selected_oom_score_adj = oom_score_adj;
+		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
+			     p->comm, p->pid, OOM_SCORE_ADJ_TO_OOM_ADJ(oom_score_adj), tasksize);
+	}
+	if (selected && (selected_oom_score_adj || is_need_lmk_kill)) {
+			struct sysinfo si;
+			si_swapinfo(&si);
+			lowmem_print(1, "Killing '%s' (%d), adj %hd,\n" \
+				"   to free %ldkB on behalf of '%s' (%d) because\n" \
+				"   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n" \
+				"   Free memory is %ldkB above reserved\n"	\
+				"   swaptotal is %ldkB, swapfree is %ldkB\n",
+			     selected->comm, selected->pid,
+			     OOM_SCORE_ADJ_TO_OOM_ADJ(selected_oom_score_adj),
+			     selected_tasksize * (long)(PAGE_SIZE / 1024),
+			     current->comm, current->pid,
+			     other_file * (long)(PAGE_SIZE / 1024),
+			     minfree * (long)(PAGE_SIZE / 1024),
+			     OOM_SCORE_ADJ_TO_OOM_ADJ(min_score_adj),
+			     other_free * (long)(PAGE_SIZE / 1024),
+			     si.totalswap * (long)(PAGE_SIZE / 1024),
+			     si.freeswap * (long)(PAGE_SIZE / 1024));
+
+			lowmem_deathpending_timeout = jiffies + HZ;
+
+			//Improve the priority of killed process can accelerate the process to die,
+			//and the process memory would be released quickly
+			boost_dying_task_prio(selected);
+
+			send_sig(SIGKILL, selected, 0);
+			set_tsk_thread_flag(selected, TIF_MEMDIE);
+			lowmem_set_deathpending(selected->group_leader);
+			rcu_read_unlock();
+#ifdef CONFIG_SEC_DEBUG_LMK_MEMINFO
+		if (__ratelimit(&lmk_rs)) {
+			dump_tasks_info();
+		}
+#endif
+			/* give the system time to free up the memory */
+			msleep_interruptible(20);
+			return selected_tasksize;
+	}
+	rcu_read_unlock();
+	return 0;
+}
+
+
 typedef struct lmk_debug_info
 {
 	short min_score_adj;
@@ -346,16 +704,11 @@ typedef struct lmk_debug_info
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
 	lmk_debug_info  lmk_info = {0};
-	struct task_struct *tsk;
-	struct task_struct *selected = NULL;
 	int rem = 0;
 	int tasksize;
 	int i;
 	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
 	int minfree = 0;
-	int selected_tasksize = 0;
-	short selected_oom_score_adj;
-	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free;
 	int other_file;
 	bool is_need_lmk_kill = true;
@@ -365,36 +718,19 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	short zram_score_adj = 0;
 #endif
 
-#ifdef CONFIG_SEC_DEBUG_LMK_MEMINFO
-	static DEFINE_RATELIMIT_STATE(lmk_rs, DEFAULT_RATELIMIT_INTERVAL, 1);
-#endif
-
 	if (nr_to_scan > 0) {
 		if (mutex_lock_interruptible(&scan_mutex) < 0)
 			return 0;
 	}
 
-	other_free = global_page_state(NR_FREE_PAGES);
-	if (global_page_state(NR_SHMEM) + total_swapcache_pages() <
-		global_page_state(NR_FILE_PAGES))
-		other_file = global_page_state(NR_FILE_PAGES) -
-						global_page_state(NR_SHMEM) -
-						total_swapcache_pages();
-	else
-		other_file = 0;
+	lowmem_other_pages(&other_free, &other_file);
 
 	tune_lmk_param(&other_free, &other_file, sc);
 
-	if (lowmem_adj_size < array_size)
-		array_size = lowmem_adj_size;
-	if (lowmem_minfree_size < array_size)
-		array_size = lowmem_minfree_size;
-	for (i = 0; i < array_size; i++) {
+	i = lowmem_level(other_free, other_file);
+	if (i >= 0) {
 		minfree = lowmem_minfree[i];
-		if (other_free < minfree && other_file < minfree) {
-			min_score_adj = lowmem_adj[i];
-			break;
-		}
+		min_score_adj = lowmem_adj[i];
 	}
 	if (nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %hd\n",
@@ -404,7 +740,9 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		global_page_state(NR_ACTIVE_FILE) +
 		global_page_state(NR_INACTIVE_ANON) +
 		global_page_state(NR_INACTIVE_FILE);
-	if (nr_to_scan <= 0 || min_score_adj == OOM_SCORE_ADJ_MAX + 1) {
+	/* in vmpressure mode the reaper thread does the killing */
+	if (nr_to_scan <= 0 || min_score_adj == OOM_SCORE_ADJ_MAX + 1 ||
+	    lowmem_vmpressure_on()) {
 		lowmem_print(5, "lowmem_shrink %lu, %x, return %d\n",
 			     nr_to_scan, sc->gfp_mask, rem);
 
@@ -463,101 +801,148 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	min_score_adj = zram_score_adj;
 #endif
 
-	selected_oom_score_adj = min_score_adj;
+	tasksize = lowmem_kill(min_score_adj, minfree, other_free, other_file,
+			       is_need_lmk_kill);
+	if (tasksize < 0) {
+		mutex_unlock(&scan_mutex);
+		return 0;
+	}
+	rem -= tasksize;
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		short oom_score_adj;
+	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
+		     nr_to_scan, sc->gfp_mask, rem);
+	mutex_unlock(&scan_mutex);
+	return rem;
+}
 
-		if (tsk->flags & PF_KTHREAD)
-			continue;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_VMPRESSURE
+/*
+ * vmpressure mode. The shrinker is called many times per reclaim pass and
+ * only kills once free and file pages are already under minfree, often
+ * after a long stretch of thrashing. Here the pressure of global reclaim
+ * (mm/vmpressure.c, one reading per window of scanned pages) decides
+ * instead: once it has stayed at or above vmpressure_medium for
+ * vmpressure_windows windows in a row, or reached vmpressure_critical, the
+ * reaper thread kills one process, and no more than one every
+ * vmpressure_kill_interval_ms. The victim's oom_score_adj comes from the
+ * minfree table as before, or from its last level while memory is still
+ * above every minfree but reclaim keeps failing.
+ */
+static int lmk_pressure_windows;
+static int lmk_reap_pending;
+static unsigned long lmk_next_kill;
+static DECLARE_WAIT_QUEUE_HEAD(lmk_reaper_wait);
+static struct task_struct *lmk_reaper;
+
+/* Runs from the vmpressure work, one window at a time. */
+static int lowmem_vmpressure_notify(struct notifier_block *nb,
+				    unsigned long pressure, void *data)
+{
+	if (!lowmem_vmpressure_on())
+		return NOTIFY_DONE;
 
-		if (test_task_flag(tsk, TIF_MEMDIE)) {
-			if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-				rcu_read_unlock();
-				/* give the system time to free up the memory */
-				msleep_interruptible(20);
-				mutex_unlock(&scan_mutex);
-				return 0;
-			}
-			continue;
-		}
+	if (pressure < lowmem_vmpressure_medium) {
+		ACCESS_ONCE(lmk_pressure_windows) = 0;
+		return NOTIFY_OK;
+	}
+	if (++lmk_pressure_windows < lowmem_vmpressure_windows &&
+	    pressure < lowmem_vmpressure_critical)
+		return NOTIFY_OK;
+
+	lowmem_print(3, "vmpressure %lu for %d windows\n", pressure,
+		     lmk_pressure_windows);
+	ACCESS_ONCE(lmk_reap_pending) = 1;
+	wake_up(&lmk_reaper_wait);
+	return NOTIFY_OK;
+}
 
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call = lowmem_vmpressure_notify,
+};
 
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-#ifdef CONFIG_ZRAM
-		tasksize = get_mm_rss(p->mm) + get_mm_counter(p->mm, MM_SWAPENTS);
-#else
-		tasksize = get_mm_rss(p->mm);
-#endif
-		task_unlock(p);
-		if (tasksize <= 0)
+static void lowmem_reap(void)
+{
+	int other_free, other_file;
+	int array_size = lowmem_nr_levels();
+	int i, freed;
+
+	if (array_size <= 0)
+		return;
+
+	mutex_lock(&scan_mutex);
+	lowmem_other_pages(&other_free, &other_file);
+	i = lowmem_level(other_free, other_file);
+	if (i < 0)
+		i = array_size - 1;
+	lowmem_print(3, "lowmem_reap ofree %d %d, ma %hd\n", other_free,
+		     other_file, lowmem_adj[i]);
+	freed = lowmem_kill(lowmem_adj[i], lowmem_minfree[i], other_free,
+			    other_file, true);
+	mutex_unlock(&scan_mutex);
+
+	if (freed > 0) {
+		/* the next kill needs pressure that outlasts this one */
+		ACCESS_ONCE(lmk_pressure_windows) = 0;
+		lmk_next_kill = jiffies +
+			msecs_to_jiffies(lowmem_vmpressure_kill_interval_ms);
+	}
+}
+
+static int lowmem_reaper(void *unused)
+{
+	struct sched_param param = { .sched_priority = 1 };
+	long delay;
+
+	sched_setscheduler_nocheck(current, SCHED_FIFO, &param);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(lmk_reaper_wait,
+					 ACCESS_ONCE(lmk_reap_pending) ||
+					 kthread_should_stop());
+		if (!xchg(&lmk_reap_pending, 0))
 			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
+
+		delay = (long)(lmk_next_kill - jiffies);
+		if (delay > 0) {
+			schedule_timeout_interruptible(delay);
+			/* pressure may have eased meanwhile */
+			if (!ACCESS_ONCE(lmk_pressure_windows))
 				continue;
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, OOM_SCORE_ADJ_TO_OOM_ADJ(oom_score_adj), tasksize);
+		lowmem_reap();
 	}
-	if (selected && (selected_oom_score_adj || is_need_lmk_kill)) {
-			struct sysinfo si;
-			si_swapinfo(&si);
-			lowmem_print(1, "Killing '%s' (%d), adj %hd,\n" \
-				"   to free %ldkB on behalf of '%s' (%d) because\n" \
-				"   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n" \
-				"   Free memory is %ldkB above reserved\n"	\
-				"   swaptotal is %ldkB, swapfree is %ldkB\n",
-			     selected->comm, selected->pid,
-			     OOM_SCORE_ADJ_TO_OOM_ADJ(selected_oom_score_adj),
-			     selected_tasksize * (long)(PAGE_SIZE / 1024),
-			     current->comm, current->pid,
-			     other_file * (long)(PAGE_SIZE / 1024),
-			     minfree * (long)(PAGE_SIZE / 1024),
-			     OOM_SCORE_ADJ_TO_OOM_ADJ(min_score_adj),
-			     other_free * (long)(PAGE_SIZE / 1024),
-			     si.totalswap * (long)(PAGE_SIZE / 1024),
-			     si.freeswap * (long)(PAGE_SIZE / 1024));
-
-			lowmem_deathpending_timeout = jiffies + HZ;
+	return 0;
+}
 
-			//Improve the priority of killed process can accelerate the process to die,
-			//and the process memory would be released quickly
-			boost_dying_task_prio(selected);
+static void __init lowmem_vmpressure_init(void)
+{
+	lmk_next_kill = jiffies;
+	lmk_reaper = kthread_run(lowmem_reaper, NULL, "lowmemorykiller");
+	if (IS_ERR(lmk_reaper)) {
+		pr_err("no reaper thread, killing from the shrinker\n");
+		lmk_reaper = NULL;
+		lowmem_vmpressure_mode = 0;
+		return;
+	}
+	vmpressure_notifier_register(&lowmem_vmpressure_nb);
+}
 
-			send_sig(SIGKILL, selected, 0);
-			set_tsk_thread_flag(selected, TIF_MEMDIE);
-			rem -= selected_tasksize;
-			rcu_read_unlock();
-#ifdef CONFIG_SEC_DEBUG_LMK_MEMINFO
-		if (__ratelimit(&lmk_rs)) {
-			dump_tasks_info();
-		}
-#endif
-			/* give the system time to free up the memory */
-			msleep_interruptible(20);
-	} else
-		rcu_read_unlock();
+static void __exit lowmem_vmpressure_exit(void)
+{
+	if (!lmk_reaper)
+		return;
+	vmpressure_notifier_unregister(&lowmem_vmpressure_nb);
+	kthread_stop(lmk_reaper);
+}
+#else
+static inline void lowmem_vmpressure_init(void)
+{
+}
 
-	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
-		     nr_to_scan, sc->gfp_mask, rem);
-	mutex_unlock(&scan_mutex);
-	return rem;
+static inline void lowmem_vmpressure_exit(void)
+{
 }
+#endif
 
 
 /*
@@ -583,6 +968,7 @@ static int android_oom_handler(struct notifier_block *nb,
 	int rem = 0;
 	int tasksize;
 	int i;
+	int adj;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
 #ifdef MULTIPLE_OOM_KILLER
 	int selected_tasksize[OOM_DEPTH] = {0,};
@@ -620,12 +1006,19 @@ static int android_oom_handler(struct notifier_block *nb,
 	selected_oom_score_adj = min_score_adj;
 #endif
 
-	read_lock(&tasklist_lock);
-	for_each_process(tsk) {
+	rcu_read_lock();
+	for_each_lmk_candidate(tsk, adj, min_score_adj) {
 		struct task_struct *p;
 		int oom_score_adj;
 #ifdef MULTIPLE_OOM_KILLER
 		int is_exist_oom_task = 0;
+
+		if (all_selected_oom == OOM_DEPTH &&
+		    adj < selected_oom_score_adj[max_selected_oom_idx])
+			break;
+#else
+		if (selected && adj < selected_oom_score_adj)
+			break;
 #endif
 
 		if (tsk->flags & PF_KTHREAD)
@@ -633,7 +1026,7 @@ static int android_oom_handler(struct notifier_block *nb,
 
 		if (test_task_flag(tsk, TIF_MEMDIE)) {
 			if (time_before_eq(jiffies, oom_deathpending_timeout)) {
-				read_unlock(&tasklist_lock);
+				rcu_read_unlock();
 				/* give the system time to free up the memory */
 				msleep_interruptible(20);
 				return 0;
@@ -744,7 +1137,7 @@ static int android_oom_handler(struct notifier_block *nb,
 #endif
 	}
 #endif
-	read_unlock(&tasklist_lock);
+	rcu_read_unlock();
 
 	/* give the system time to free up the memory */
 	msleep_interruptible(20);
@@ -766,6 +1159,8 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	lmk_index_init();
+	lowmem_vmpressure_init();
 	register_shrinker(&lowmem_shrinker);
 #ifdef CONFIG_OOM_NOTIFIER
 	register_oom_notifier(&android_oom_notifier);
@@ -776,6 +1171,7 @@ static int __init lowmem_init(void)
 static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
+	lowmem_vmpressure_exit();
 }
 
 #ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_AUTODETECT_OOM_ADJ_VALUES
@@ -897,6 +1293,18 @@ module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 module_param_named(lmk_fast_run, lmk_fast_run, int, S_IRUGO | S_IWUSR);
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_VMPRESSURE
+module_param_named(vmpressure_mode, lowmem_vmpressure_mode, int,
+		   S_IRUGO | S_IWUSR);
+module_param_named(vmpressure_medium, lowmem_vmpressure_medium, int,
+		   S_IRUGO | S_IWUSR);
+module_param_named(vmpressure_critical, lowmem_vmpressure_critical, int,
+		   S_IRUGO | S_IWUSR);
+module_param_named(vmpressure_windows, lowmem_vmpressure_windows, int,
+		   S_IRUGO | S_IWUSR);
+module_param_named(vmpressure_kill_interval_ms,
+		   lowmem_vmpressure_kill_interval_ms, int, S_IRUGO | S_IWUSR);
+#endif
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -39,6 +39,7 @@ struct sched_param {
 #include <linux/seccomp.h>
 #include <linux/rcupdate.h>
 #include <linux/rculist.h>
+#include <linux/list_nulls.h>
 #include <linux/rtmutex.h>
 
 #include <linux/time.h>
@@ -770,6 +771,14 @@ enum cpu_idle_type {
 #define SCHED_POWER_SHIFT	10
 #define SCHED_POWER_SCALE	(1L << SCHED_POWER_SHIFT)
 
+#ifdef CONFIG_SMP
+extern void sched_wrr_set_capacity(int cpu, unsigned long capacity);
+extern unsigned int sysctl_sched_wrr_steal;
+extern unsigned int sysctl_sched_wrr_cluster;
+#else
+static inline void sched_wrr_set_capacity(int cpu, unsigned long capacity) { }
+#endif
+
 /*
  * sched-domains (multiprocessor balancing) declarations:
  */
@@ -1054,6 +1063,10 @@ struct sched_wrr_entity{
 	struct list_head run_list; 
 	unsigned int weight;
 	unsigned int time_slice;
+#ifdef CONFIG_NUMA
+	int home_node;			/* node most of its memory is on */
+	int home_ticks;			/* confidence in home_node */
+#endif
 };
 
 struct rcu_node;
@@ -1127,6 +1140,11 @@ struct task_struct {         /* task_struct revisitted~~~~~~~~~~~~~~~~~~~~~~~~~~
 #endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	/* lowmemorykiller bucket, valid for thread group leaders */
+	struct hlist_nulls_node lmk_node;
+	short lmk_adj;
+#endif
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
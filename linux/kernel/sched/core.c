@@ -113,7 +113,6 @@ int sched_setweight(pid_t pid, int weight)
 {
 	struct task_struct *p;
 	int delta;
-	struct rq *rq;
 	kuid_t root_uid = KUIDT_INIT(0);
 
 	if (weight < 1 || weight > 20) {
@@ -141,9 +140,7 @@ int sched_setweight(pid_t pid, int weight)
 		return -EINVAL;
 	}
 
-	p->wrr.weight = weight;
-	rq = cpu_rq(task_cpu(p));
-	rq->wrr.total_weight -= delta;
+	sched_set_wrr_weight(p, weight);
 
 	return 0;
 }
@@ -172,99 +169,6 @@ int sched_getweight(pid_t pid)
 }
 
 /*set_weight, get_weight system calls*/
-/*load_balance*/
-
-static int is_migratable(struct rq *rq, struct task_struct *p, int dest_cpu)
-{
-	if (rq->curr == p)
-		return 0;
-	if (!cpumask_test_cpu(dest_cpu, tsk_cpus_allowed(p)))
-		return 0;
-
-	return 1;
-}
-
-#define LB_INTERVAL (2 * HZ)
-DEFINE_SPINLOCK(balance_lock);
-unsigned long balance_timestamp;
-
-/*load_balance*/
-
-static void load_balance_wrr(struct rq *rq)
-{
-	int cpu;
-	unsigned int max_weight = rq->wrr.total_weight;
-	unsigned int min_weight = rq->wrr.total_weight;
-	struct rq *min_rq = rq;
-	struct rq *max_rq = rq;
-	struct rq *temp;
-	struct wrr_rq *wrr;
-	struct list_head *list;
-	struct sched_wrr_entity *se, *n;
-	struct task_struct *mp; /* migrating task */
-	unsigned int mweight;
-	struct task_struct *p;
-	unsigned long now;
-
-	spin_lock(&balance_lock);
-
-	now = jiffies;
-	if (time_before(now, balance_timestamp + LB_INTERVAL)) {
-		spin_unlock(&balance_lock);
-		return;
-	}
-
-	balance_timestamp = now;
-
-	spin_unlock(&balance_lock);
-
-	/*find min, max rq*/
-	rcu_read_lock();
-	for_each_online_cpu(cpu) {
-		temp = cpu_rq(cpu);
-		wrr = &temp->wrr;
-
-		if (wrr->total_weight < min_weight) {
-			min_rq = temp;
-			min_weight = wrr->total_weight;
-		}
-		if (wrr->total_weight > max_weight) {
-			max_rq = temp;
-			max_weight = wrr->total_weight;
-		}
-	}
-	rcu_read_unlock();
-
-	if (min_rq == max_rq)
-		return;
-
-	double_rq_lock(max_rq, min_rq);
-
-	mweight = 0;
-	mp = NULL;
-	list = &max_rq->wrr.run_queue;
-
-	list_for_each_entry_safe(se, n, list, run_list) {
-		p = container_of(se, struct task_struct, wrr);
-		if (is_migratable(max_rq, p, min_rq->cpu) &&
-				se->weight > mweight &&
-				min_weight + se->weight < max_weight - se->weight) {
-			mp = p;
-			mweight = se->weight;
-		}
-	}
-
-	if (mp == NULL) {
-		double_rq_unlock(max_rq, min_rq);
-		return;
-	}
-
-	deactivate_task(max_rq, mp, 0);
-	set_task_cpu(mp, min_rq->cpu);
-	activate_task(min_rq, mp, 0);
-
-	double_rq_unlock(max_rq, min_rq);
-}
 
 void start_bandwidth_timer(struct hrtimer *period_timer, ktime_t period)
 {
@@ -529,6 +433,20 @@ task_rq_unlock(struct rq *rq, struct task_struct *p, unsigned long *flags)
 	raw_spin_unlock_irqrestore(&p->pi_lock, *flags);
 }
 
+/*
+ * sched_set_wrr_weight - change the SCHED_WRR weight of @p under its rq lock
+ * so that the total_weight of the wrr_rq it may be queued on stays in sync.
+ */
+void sched_set_wrr_weight(struct task_struct *p, unsigned int weight)
+{
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+	set_weight_wrr(rq, p, weight);
+	task_rq_unlock(rq, p, &flags);
+}
+
 /*
  * this_rq_lock - lock this runqueue and disable interrupts.
  */
@@ -3222,6 +3140,11 @@ need_resched:
 
 	pre_schedule(rq, prev);
 
+#ifdef CONFIG_SMP
+	/* WRR tasks are not counted in nr_running */
+	if (unlikely(!rq->nr_running && !rq->wrr.total_weight))
+		idle_steal_wrr(rq);
+#endif
 	if (unlikely(!rq->nr_running))
 		idle_balance(cpu, rq);
 
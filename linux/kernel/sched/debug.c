@@ -38,7 +38,11 @@ void print_wrr_stats(struct seq_file *m, int cpu)
 	struct wrr_rq *wrr_rq = &cpu_rq(cpu)->wrr;
 	struct sched_wrr_entity *wrr_se;
 	struct task_struct *tsk;
-	SEQ_printf(m, "\nwrr_rq[%d]\n", cpu);
+	SEQ_printf(m, "\nwrr_rq[%d] capacity %lu\n", cpu, wrr_rq->capacity);
+#ifdef CONFIG_SMP
+	SEQ_printf(m, "stealable %lu, steals %lu\n", wrr_rq->stealable,
+		   wrr_rq->nr_steals);
+#endif
 	list_for_each_entry(wrr_se, &wrr_rq->run_queue, run_list) {
 		tsk = container_of(wrr_se, struct task_struct, wrr);
 		SEQ_printf(m, "pid %d with weight %d\n", tsk->pid, tsk->wrr.weight);
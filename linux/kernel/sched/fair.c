@@ -6807,6 +6807,8 @@ static void nohz_idle_balance(int this_cpu, enum cpu_idle_type idle)
 	    !test_bit(NOHZ_BALANCE_KICK, nohz_flags(this_cpu)))
 		goto end;
 
+	nohz_pull_wrr(this_rq);
+
 	for_each_cpu(balance_cpu, nohz.idle_cpus_mask) {
 		if (balance_cpu == this_cpu || !idle_cpu(balance_cpu))
 			continue;
@@ -6827,6 +6829,7 @@ static void nohz_idle_balance(int this_cpu, enum cpu_idle_type idle)
 		raw_spin_unlock_irq(&rq->lock);
 
 		rebalance_domains(balance_cpu, CPU_IDLE);
+		nohz_pull_wrr(rq);
 
 		if (time_after(this_rq->next_balance, rq->next_balance))
 			this_rq->next_balance = rq->next_balance;
@@ -6885,6 +6888,10 @@ static inline int nohz_kick_needed(struct rq *rq, int cpu)
 	if (rq->nr_running >= 2)
 		goto need_kick;
 
+	/* WRR tasks are not in nr_running; kick if one of them could move */
+	if (ACCESS_ONCE(rq->wrr.stealable))
+		goto need_kick;
+
 	rcu_read_lock();
 	for_each_domain(cpu, sd) {
 		struct sched_group *sg = sd->groups;
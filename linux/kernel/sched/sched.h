@@ -233,8 +233,31 @@ struct wrr_rq {
 	struct list_head run_queue;
 	struct task_struct* curr;
 	raw_spinlock_t lock;
+	unsigned long capacity;	/* thermal capacity, SCHED_POWER_SCALE is full speed */
+#ifdef CONFIG_SMP
+	unsigned long stealable;	/* weight behind the cursor, read locklessly */
+	unsigned long nr_steals;	/* tasks pulled in by this cpu */
+	unsigned long next_steal;	/* jiffies, busy cpus steal no earlier */
+#endif
+};
+
+#ifdef CONFIG_SCHED_WRR_SELFTEST
+enum {
+	WRR_COST_ENQUEUE,
+	WRR_COST_DEQUEUE,
+	WRR_COST_PICK,
+	WRR_COST_BALANCE,
+	NR_WRR_COST,
+};
+
+struct wrr_cost {
+	u64 cycles[NR_WRR_COST];
+	unsigned long count[NR_WRR_COST];
 };
 
+DECLARE_PER_CPU(struct wrr_cost, wrr_cost);
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 #endif
@@ -1343,6 +1366,24 @@ extern void init_cfs_rq(struct cfs_rq *cfs_rq);
 extern void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq);
 
 extern void init_wrr_rq(struct wrr_rq *wrr_rq, struct rq *rq); /* same as above */
+extern void set_weight_wrr(struct rq *rq, struct task_struct *p, unsigned int weight);
+extern void sched_set_wrr_weight(struct task_struct *p, unsigned int weight);
+#ifdef CONFIG_SMP
+/* what two cpus share, for the migration cost model (wrr_cost.c) */
+enum {
+	WRR_LEVEL_SMT,
+	WRR_LEVEL_CLUSTER,
+	WRR_LEVEL_NODE,
+	WRR_LEVEL_REMOTE,
+	WRR_NR_LEVELS,
+};
+
+extern u64 wrr_migration_cost[WRR_NR_LEVELS];
+extern int wrr_level(int src, int dst);
+extern void load_balance_wrr(struct rq *rq);
+extern void idle_steal_wrr(struct rq *rq);
+extern void nohz_pull_wrr(struct rq *rq);
+#endif
 
 extern void cfs_bandwidth_usage_inc(void);
 extern void cfs_bandwidth_usage_dec(void);
@@ -8,9 +8,20 @@
 #include <linux/slab.h>
 #include <linux/cpumask.h>
 #include <linux/rcupdate.h>
+#include <linux/topology.h>
+#include <linux/random.h>
 #define WRR_TIMESLICE (HZ / 100)
 #define LB_INTERVAL (2 * HZ)
 
+/*
+ * A cpu on another node than the task's home must be this much (percent)
+ * less loaded to be chosen, and a cross-node move must leave the source
+ * this much more loaded than the destination.
+ */
+#define WRR_NUMA_IMBALANCE_PCT 125
+/* most ticks a task can run away from home_node before home_node moves */
+#define WRR_HOME_TICKS_MAX (HZ / 2)
+
 const struct sched_class wrr_sched_class;
 
 static inline struct list_head *wrr_rq_list(struct wrr_rq *wrr_rq)
@@ -32,15 +43,79 @@ static inline struct task_struct *wrr_task_of(struct sched_wrr_entity *wrr_se)
 	return container_of(wrr_se, struct task_struct, wrr);
 }
 
+#ifdef CONFIG_SCHED_WRR_SELFTEST
+/* cycles spent in the hot class operations, read by wrr_selftest.c */
+DEFINE_PER_CPU(struct wrr_cost, wrr_cost);
+
+static inline void wrr_cost_account(int op, cycles_t start)
+{
+	__this_cpu_add(wrr_cost.cycles[op], get_cycles() - start);
+	__this_cpu_inc(wrr_cost.count[op]);
+}
+
+#define WRR_COST(op, call)					\
+	do {							\
+		cycles_t __start = get_cycles();		\
+		call;						\
+		wrr_cost_account(op, __start);			\
+	} while (0)
+#else
+#define WRR_COST(op, call)	call
+#endif
+
+/*
+ * Load of a wrr_rq as seen by placement and balancing: a weight scaled by
+ * the share of its full speed the cpu may currently run at, so a cpu that
+ * is thermally capped to half its frequency looks twice as loaded.
+ */
+static inline unsigned long wrr_load(struct wrr_rq *wrr, unsigned long weight)
+{
+	return weight * SCHED_POWER_SCALE / wrr->capacity;
+}
+
+/*
+ * Publish the weight queued behind the cursor, which other cpus may take,
+ * for lockless readers in the stealing path. Called with wrr->lock held
+ * whenever total_weight or the cursor changes.
+ */
+static inline void wrr_advertise(struct wrr_rq *wrr)
+{
+#ifdef CONFIG_SMP
+	unsigned long stealable = 0;
+
+	if (wrr->curr)
+		stealable = wrr->total_weight - wrr->curr->wrr.weight;
+	ACCESS_ONCE(wrr->stealable) = stealable;
+#endif
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Called by cpufreq when a thermal limit changes the highest frequency
+ * @cpu may run at. @capacity is relative to SCHED_POWER_SCALE.
+ */
+void sched_wrr_set_capacity(int cpu, unsigned long capacity)
+{
+	capacity = clamp_t(unsigned long, capacity, 1, SCHED_POWER_SCALE);
+	ACCESS_ONCE(cpu_rq(cpu)->wrr.capacity) = capacity;
+}
+#endif
+
 extern void init_wrr_rq(struct wrr_rq *wrr_rq, struct rq *rq)
 {
 	wrr_rq->total_weight = 0;
+	wrr_rq->capacity = SCHED_POWER_SCALE;
 	INIT_LIST_HEAD(&wrr_rq->run_queue);
 	wrr_rq->curr = NULL;
 	raw_spin_lock_init(&wrr_rq->lock);
+#ifdef CONFIG_SMP
+	wrr_rq->stealable = 0;
+	wrr_rq->nr_steals = 0;
+	wrr_rq->next_steal = jiffies;
+#endif
 }
 
-static void enqueue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
+static void __enqueue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
 {
 	struct wrr_rq *wrr;
 	struct sched_wrr_entity *se;
@@ -65,6 +140,15 @@ static void enqueue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
 		 */
 		wrr->curr = p;
 		list_add_tail(se_list, rq_list);
+	} else if (flags & ENQUEUE_HEAD) {
+		/*
+		 * A task moved here by the balancer has already waited its
+		 * turn elsewhere: queue it right after the cursor
+		 */
+		curr_se = &wrr->curr->wrr;
+		curr_list = &curr_se->run_list;
+
+		list_add(se_list, curr_list);
 	} else {
 		/*
 		 * If the list is not empty,
@@ -78,11 +162,12 @@ static void enqueue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
 
 	wrr->total_weight += se->weight;
 	p->on_rq = 1;
+	wrr_advertise(wrr);
 
 	raw_spin_unlock(&wrr->lock);
 }
 
-static void dequeue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
+static void __dequeue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
 {
 	struct list_head *se_list;
 	struct list_head *rq_list;
@@ -117,16 +202,27 @@ static void dequeue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
 
 	wrr->total_weight -= se->weight;
 	p->on_rq = 0;
+	wrr_advertise(wrr);
 
 	raw_spin_unlock(&wrr->lock);
 }
 
+static void enqueue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
+{
+	WRR_COST(WRR_COST_ENQUEUE, __enqueue_task_wrr(rq, p, flags));
+}
+
+static void dequeue_task_wrr(struct rq *rq, struct task_struct *p, int flags)
+{
+	WRR_COST(WRR_COST_DEQUEUE, __dequeue_task_wrr(rq, p, flags));
+}
+
 static void check_preempt_curr_wrr(struct rq *rq, struct task_struct *p, int flags)
 {
 	return;
 }
 
-static struct task_struct *pick_next_task_wrr(struct rq *rq)
+static struct task_struct *__pick_next_task_wrr(struct rq *rq)
 {
 	struct task_struct *curr = rq->wrr.curr;
 
@@ -137,33 +233,137 @@ static struct task_struct *pick_next_task_wrr(struct rq *rq)
 	return curr;
 }
 
+static struct task_struct *pick_next_task_wrr(struct rq *rq)
+{
+	struct task_struct *p;
+
+	WRR_COST(WRR_COST_PICK, p = __pick_next_task_wrr(rq));
+	return p;
+}
+
 static void put_prev_task_wrr(struct rq *rq, struct task_struct *p)
 {
 	return;
 }
 
+#ifdef CONFIG_NUMA
+/*
+ * Pages are allocated first-touch, so the node a task has mostly run on is
+ * the node holding most of its memory. Track it with a majority vote over
+ * ticks: running at home builds up home_ticks, running elsewhere wears it
+ * down, and once it is gone the current node becomes the new home.
+ */
+static void update_home_node(struct rq *rq, struct task_struct *p)
+{
+	struct sched_wrr_entity *se = &p->wrr;
+	int node = cpu_to_node(rq->cpu);
+
+	if (node == se->home_node) {
+		if (se->home_ticks < WRR_HOME_TICKS_MAX)
+			se->home_ticks++;
+	} else if (--se->home_ticks <= 0) {
+		se->home_node = node;
+		se->home_ticks = 1;
+	}
+}
+
+/* NUMA_NO_NODE until the task has run long enough to have a home */
+static inline int wrr_home_node(struct task_struct *p)
+{
+	return p->wrr.home_ticks > 0 ? p->wrr.home_node : NUMA_NO_NODE;
+}
+#else
+static inline void update_home_node(struct rq *rq, struct task_struct *p)
+{
+}
+
+static inline int wrr_home_node(struct task_struct *p)
+{
+	return NUMA_NO_NODE;
+}
+#endif
+
+/*
+ * Load of the other hardware threads of cpu's core. They compete with cpu
+ * for the execution units, so an idle thread next to a busy one is a worse
+ * place to run than a core that is idle as a whole.
+ */
+static unsigned long wrr_sibling_load(int cpu)
+{
+	struct wrr_rq *wrr;
+	unsigned long load = 0;
+	int sibling;
+
+	for_each_cpu(sibling, topology_thread_cpumask(cpu)) {
+		if (sibling == cpu || !cpu_online(sibling))
+			continue;
+		wrr = &cpu_rq(sibling)->wrr;
+		load += wrr_load(wrr, wrr->total_weight);
+	}
+	return load;
+}
+
 static int find_lowest_rq(struct task_struct *p)
 {
 	int cpu;
 	struct rq *rq;
 	int best_cpu;
-	unsigned long best_weight;
-	struct wrr_rq *wrr;
+	int home;
+	unsigned long load, best_load;
+	struct wrr_rq *wrr, *best;
 
 	best_cpu = -1;
+	best_load = 0;
+	best = NULL;
+	home = wrr_home_node(p);
 
 	for_each_online_cpu(cpu) {
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
 		rq = cpu_rq(cpu);
 		wrr = &rq->wrr;
-		if ((best_cpu == -1 || wrr->total_weight < best_weight) &&
-				cpumask_test_cpu(cpu, tsk_cpus_allowed(p))) {
+		/*
+		 * Compare the load each cpu would have with p on it, so a
+		 * heavy task is steered away from throttled cpus more
+		 * strongly than a light one. Busy SMT siblings count half,
+		 * and cpus away from p's memory need a margin to win. On a
+		 * tie take the faster cpu.
+		 */
+		load = wrr_load(wrr, wrr->total_weight + p->wrr.weight);
+		load += wrr_sibling_load(cpu) / 2;
+		if (home != NUMA_NO_NODE && cpu_to_node(cpu) != home)
+			load = load * WRR_NUMA_IMBALANCE_PCT / 100;
+		if (best_cpu == -1 || load < best_load ||
+		    (load == best_load && wrr->capacity > best->capacity)) {
 			best_cpu = cpu;
-			best_weight = wrr->total_weight;
+			best_load = load;
+			best = wrr;
 		}
 	}
 	return best_cpu;
 }
 
+/*
+ * A sync waker goes to sleep right after the wakeup, as a binder client
+ * does once its transaction is queued. Run p in its place then, on a cpu
+ * whose caches hold what p was just handed, unless other WRR work waits
+ * there. Returns -1 if p should be placed as usual.
+ */
+static int wrr_sync_cpu(struct task_struct *p)
+{
+	int cpu = smp_processor_id();
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long waker = 0;
+
+	if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+		return -1;
+	if (rq->curr && rq->curr->policy == SCHED_WRR)
+		waker = rq->curr->wrr.weight;
+	if (rq->wrr.total_weight > waker)
+		return -1;
+	return cpu;
+}
+
 static int select_task_rq_wrr(struct task_struct *p, int sd_flag, int flags)
 {
 	struct rq *rq;
@@ -174,6 +374,12 @@ static int select_task_rq_wrr(struct task_struct *p, int sd_flag, int flags)
 	if (p->nr_cpus_allowed == 1)
 		return cpu;
 
+	if (flags & WF_SYNC) {
+		target = wrr_sync_cpu(p);
+		if (target != -1)
+			return target;
+	}
+
 	rq = cpu_rq(cpu);
 
 	rcu_read_lock();
@@ -224,6 +430,7 @@ static void update_curr(struct rq *rq)
 		if (next == &wrr_rq->run_queue)
 			next = next->next;
 		wrr_rq->curr = wrr_task_of(list_entry(next, struct sched_wrr_entity, run_list));
+		wrr_advertise(wrr_rq);
 		set_tsk_need_resched(curr);
 	} else
 		se->time_slice = se->weight * WRR_TIMESLICE; /* < Else, refill the current task's time_slice */
@@ -231,8 +438,450 @@ static void update_curr(struct rq *rq)
 	raw_spin_unlock(&wrr_rq->lock);
 }
 
+/*
+ * Change the weight of p, which lives on rq (locked by the caller). Only a
+ * queued task contributes to total_weight; a sleeping task picks up its new
+ * weight when it is enqueued again.
+ */
+void set_weight_wrr(struct rq *rq, struct task_struct *p, unsigned int weight)
+{
+	struct wrr_rq *wrr = &rq->wrr;
+
+	raw_spin_lock(&wrr->lock);
+
+	if (p->on_rq) {
+		wrr->total_weight -= p->wrr.weight;
+		wrr->total_weight += weight;
+	}
+	p->wrr.weight = weight;
+	wrr_advertise(wrr);
+
+	raw_spin_unlock(&wrr->lock);
+}
+
+#ifdef CONFIG_SMP
+static int is_migratable(struct rq *rq, struct task_struct *p, int dest_cpu)
+{
+	if (rq->curr == p)
+		return 0;
+	if (!cpumask_test_cpu(dest_cpu, tsk_cpus_allowed(p)))
+		return 0;
+
+	return 1;
+}
+
+/* ns a task loses refilling caches after a move, measured in wrr_cost.c */
+u64 wrr_migration_cost[WRR_NR_LEVELS];
+
+int wrr_level(int src, int dst)
+{
+	if (cpumask_test_cpu(dst, topology_thread_cpumask(src)))
+		return WRR_LEVEL_SMT;
+	if (cpumask_test_cpu(dst, topology_core_cpumask(src)))
+		return WRR_LEVEL_CLUSTER;
+	if (cpu_to_node(src) == cpu_to_node(dst))
+		return WRR_LEVEL_NODE;
+	return WRR_LEVEL_REMOTE;
+}
+
+/*
+ * The cpu time, in ns, a task of weight w on src can expect to gain over
+ * the next interval jiffies by moving to dst: its share of a cpu is its
+ * weight over the total on the cpu, scaled by the cpu's capacity.
+ */
+static u64 wrr_migration_gain(struct rq *src, struct rq *dst,
+			      unsigned int w, unsigned long interval)
+{
+	unsigned long before, after;
+
+	before = w * src->wrr.capacity / src->wrr.total_weight;
+	after = w * dst->wrr.capacity / (dst->wrr.total_weight + w);
+	if (after <= before)
+		return 0;
+	return ((u64)(after - before) * interval * TICK_NSEC) >>
+		SCHED_POWER_SHIFT;
+}
+
+/*
+ * The heaviest task on src that can move to dst without reversing the
+ * imbalance between them, or NULL. Ending up even is fine: two equal
+ * tasks on one cpu and none on another must be split. Any waiting task
+ * is better off on an idle dst, whatever the weights. A move must also
+ * gain the task more cpu time over the next interval jiffies than the
+ * caches it leaves behind cost it. Both runqueues are locked.
+ */
+static struct task_struct *pick_migrate_task_wrr(struct rq *src, struct rq *dst,
+						 unsigned long interval)
+{
+	u64 cost = wrr_migration_cost[wrr_level(src->cpu, dst->cpu)];
+	unsigned int src_weight = src->wrr.total_weight;
+	unsigned int dst_weight = dst->wrr.total_weight;
+	struct sched_wrr_entity *se;
+	struct task_struct *mp; /* migrating task */
+	unsigned int mweight;
+	unsigned int pct;
+	int node, cross, homeward, mhome;
+	struct task_struct *p;
+
+	mweight = 0;
+	mhome = 0;
+	mp = NULL;
+
+	node = cpu_to_node(dst->cpu);
+	cross = node != cpu_to_node(src->cpu);
+
+	list_for_each_entry(se, &src->wrr.run_queue, run_list) {
+		p = container_of(se, struct task_struct, wrr);
+		if (!is_migratable(src, p, dst->cpu) ||
+				se->weight > src_weight)
+			continue;
+		/*
+		 * Across nodes, a task whose memory is on the destination
+		 * goes home: it is preferred and needs no extra imbalance.
+		 */
+		homeward = cross && wrr_home_node(p) == node;
+		pct = cross && !homeward ? WRR_NUMA_IMBALANCE_PCT : 100;
+		if (dst_weight &&
+				wrr_load(&dst->wrr, dst_weight + se->weight) * pct / 100 >
+				wrr_load(&src->wrr, src_weight - se->weight))
+			continue;
+		if (cost && wrr_migration_gain(src, dst, se->weight, interval) <= cost)
+			continue;
+		if (homeward > mhome || (homeward == mhome && se->weight > mweight)) {
+			mp = p;
+			mweight = se->weight;
+			mhome = homeward;
+		}
+	}
+	return mp;
+}
+
+static void move_task_wrr(struct rq *src, struct rq *dst, struct task_struct *p)
+{
+	deactivate_task(src, p, 0);
+	set_task_cpu(p, dst->cpu);
+	activate_task(dst, p, ENQUEUE_HEAD);
+	/* wake dst if it was idle */
+	check_preempt_curr(dst, p, 0);
+}
+
+/*
+ * Cluster mode (kernel.sched_wrr_cluster): the cpus of a cluster sharing
+ * a cache (topology_core_cpumask) behave as one runqueue. The rings stay
+ * per cpu, since a task must sit on the rq of the cpu that runs it, but a
+ * cpu that runs dry takes waiting work from a sibling at once, and a busy
+ * one evens itself out against its busiest sibling several times more
+ * often than across clusters, as such moves refill no cache. The central
+ * balancer only moves work between clusters.
+ */
+unsigned int sysctl_sched_wrr_cluster;
+
+#define WRR_CLUSTER_INTERVAL (HZ / 10)	/* between pulls by a busy cpu */
+
+/* The busiest cpu of span other than this_rq that has work waiting, or NULL. */
+static struct rq *busiest_wrr(struct rq *this_rq, const struct cpumask *span)
+{
+	unsigned long load, max_load = 0;
+	struct rq *busiest = NULL;
+	struct wrr_rq *wrr;
+	int cpu;
+
+	for_each_cpu(cpu, span) {
+		if (cpu == this_rq->cpu || !cpu_online(cpu))
+			continue;
+		wrr = &cpu_rq(cpu)->wrr;
+		if (!ACCESS_ONCE(wrr->stealable))
+			continue;
+		load = wrr_load(wrr, ACCESS_ONCE(wrr->total_weight));
+		if (load > max_load) {
+			max_load = load;
+			busiest = cpu_rq(cpu);
+		}
+	}
+	return busiest;
+}
+
+/*
+ * Pull one task from the busiest cpu of span to this_rq, which is locked.
+ * interval is how long, in jiffies, the move has to pay for itself.
+ */
+static int pull_busiest_wrr(struct rq *this_rq, const struct cpumask *span,
+			    unsigned long interval)
+{
+	struct task_struct *p;
+	struct rq *src;
+
+	src = busiest_wrr(this_rq, span);
+	if (!src)
+		return 0;
+
+	double_lock_balance(this_rq, src);
+	p = pick_migrate_task_wrr(src, this_rq, interval);
+	if (p)
+		move_task_wrr(src, this_rq, p);
+	double_unlock_balance(this_rq, src);
+
+	return p != NULL;
+}
+
+/* Pull one task from a sibling to this_rq, which is locked. */
+static int __cluster_pull_wrr(struct rq *this_rq)
+{
+	return pull_busiest_wrr(this_rq, topology_core_cpumask(this_rq->cpu),
+				WRR_CLUSTER_INTERVAL);
+}
+
+/* The busiest (or idlest) online cpu of rq's cluster. */
+static struct rq *cluster_extreme_wrr(struct rq *rq, int busiest)
+{
+	unsigned long load, best_load;
+	struct wrr_rq *wrr;
+	struct rq *best = rq;
+	int cpu;
+
+	best_load = wrr_load(&rq->wrr, rq->wrr.total_weight);
+	for_each_cpu(cpu, topology_core_cpumask(rq->cpu)) {
+		if (!cpu_online(cpu))
+			continue;
+		wrr = &cpu_rq(cpu)->wrr;
+		load = wrr_load(wrr, wrr->total_weight);
+		if (busiest ? load > best_load : load < best_load) {
+			best = cpu_rq(cpu);
+			best_load = load;
+		}
+	}
+	return best;
+}
+
+/*
+ * How loaded the central balancer considers cpu: its own load, or in
+ * cluster mode the average over its cluster.
+ */
+static unsigned long balance_load_wrr(int cpu)
+{
+	unsigned long load = 0;
+	struct wrr_rq *wrr;
+	int sibling, n = 0;
+
+	if (!sysctl_sched_wrr_cluster) {
+		wrr = &cpu_rq(cpu)->wrr;
+		return wrr_load(wrr, wrr->total_weight);
+	}
+
+	for_each_cpu(sibling, topology_core_cpumask(cpu)) {
+		if (!cpu_online(sibling))
+			continue;
+		wrr = &cpu_rq(sibling)->wrr;
+		load += wrr_load(wrr, wrr->total_weight);
+		n++;
+	}
+	return n ? load / n : 0;
+}
+
+static DEFINE_SPINLOCK(balance_lock);
+static unsigned long balance_timestamp;
+
+/*
+ * Move the heaviest migratable task from the heaviest to the lightest
+ * wrr_rq if that does not reverse the imbalance.
+ */
+static void balance_extremes_wrr(struct rq *rq)
+{
+	int cpu;
+	unsigned long load;
+	unsigned long max_load = balance_load_wrr(rq->cpu);
+	unsigned long min_load = max_load;
+	struct rq *min_rq = rq;
+	struct rq *max_rq = rq;
+	struct rq *temp;
+	struct task_struct *mp; /* migrating task */
+
+	/*find min, max rq*/
+	rcu_read_lock();
+	for_each_online_cpu(cpu) {
+		temp = cpu_rq(cpu);
+		load = balance_load_wrr(cpu);
+
+		if (load < min_load) {
+			min_rq = temp;
+			min_load = load;
+		}
+		if (load > max_load) {
+			max_rq = temp;
+			max_load = load;
+		}
+	}
+	if (sysctl_sched_wrr_cluster) {
+		max_rq = cluster_extreme_wrr(max_rq, 1);
+		min_rq = cluster_extreme_wrr(min_rq, 0);
+		if (cpumask_test_cpu(min_rq->cpu,
+				     topology_core_cpumask(max_rq->cpu)))
+			min_rq = max_rq;
+	}
+	rcu_read_unlock();
+
+	if (min_rq == max_rq)
+		return;
+
+	double_rq_lock(max_rq, min_rq);
+
+	mp = pick_migrate_task_wrr(max_rq, min_rq, LB_INTERVAL);
+	if (mp)
+		move_task_wrr(max_rq, min_rq, mp);
+
+	double_rq_unlock(max_rq, min_rq);
+}
+
+/*
+ * Called from scheduler_tick on every cpu. At most once per LB_INTERVAL,
+ * one of them balances the extremes; only that call is costed.
+ */
+static void __load_balance_wrr(struct rq *rq)
+{
+	unsigned long now;
+
+	spin_lock(&balance_lock);
+
+	now = jiffies;
+	if (time_before(now, balance_timestamp + LB_INTERVAL)) {
+		spin_unlock(&balance_lock);
+		return;
+	}
+
+	balance_timestamp = now;
+
+	spin_unlock(&balance_lock);
+
+	WRR_COST(WRR_COST_BALANCE, balance_extremes_wrr(rq));
+}
+
+/*
+ * Distributed mode (kernel.sched_wrr_steal): instead of one cpu moving
+ * work between the global extremes every LB_INTERVAL, each cpu that is
+ * idle or lighter than a neighbour pulls work itself. Victims are picked
+ * at random, first on this cpu's node and then anywhere, and are judged
+ * from the stealable weight they advertise without taking any lock. Only
+ * a promising victim is locked, and only with a trylock, so thieves never
+ * queue up behind each other or behind the victim.
+ */
+unsigned int sysctl_sched_wrr_steal;
+
+#define WRR_STEAL_TRIES 2	/* random victims per level */
+#define WRR_STEAL_INTERVAL (HZ / 2)	/* between steals by a busy cpu */
+
+static int wrr_random_cpu(const struct cpumask *mask)
+{
+	int cpu;
+
+	cpu = cpumask_next((int)(prandom_u32() % nr_cpu_ids) - 1, mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first(mask);
+	return cpu;
+}
+
+/* Pull one task to this_rq, which is locked. Returns 1 if it did. */
+static int __steal_wrr(struct rq *this_rq)
+{
+	const struct cpumask *span[2];
+	unsigned long load;
+	struct wrr_rq *wrr;
+	struct rq *victim;
+	struct task_struct *p;
+	int level, i, cpu;
+
+	span[0] = cpumask_of_node(cpu_to_node(this_rq->cpu));
+	span[1] = cpu_online_mask;
+	load = wrr_load(&this_rq->wrr, this_rq->wrr.total_weight);
+
+	for (level = 0; level < 2; level++) {
+		for (i = 0; i < WRR_STEAL_TRIES; i++) {
+			cpu = wrr_random_cpu(span[level]);
+			if (cpu >= nr_cpu_ids || cpu == this_rq->cpu ||
+			    !cpu_online(cpu))
+				continue;
+			victim = cpu_rq(cpu);
+			wrr = &victim->wrr;
+			if (!ACCESS_ONCE(wrr->stealable) ||
+			    wrr_load(wrr, ACCESS_ONCE(wrr->total_weight)) <= load)
+				continue;
+			if (!raw_spin_trylock(&victim->lock))
+				continue;
+
+			p = pick_migrate_task_wrr(victim, this_rq,
+						  WRR_STEAL_INTERVAL);
+			if (p) {
+				move_task_wrr(victim, this_rq, p);
+				this_rq->wrr.nr_steals++;
+			}
+			raw_spin_unlock(&victim->lock);
+			if (p)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Pull work to rq, which is locked: from the cluster first, then from
+ * random victims.
+ */
+static void __pull_wrr(struct rq *rq)
+{
+	if (sysctl_sched_wrr_cluster && __cluster_pull_wrr(rq))
+		return;
+	if (sysctl_sched_wrr_steal)
+		__steal_wrr(rq);
+}
+
+/*
+ * Called by the nohz idle balancer, on the kicked cpu, for itself and each
+ * cpu whose tick is stopped in idle. Nothing else would pull WRR work to
+ * those cpus until they wake up: they run neither load_balance_wrr() nor
+ * schedule(). The kick comes from a busy cpu advertising stealable WRR
+ * weight (nohz_kick_needed()), so only cpus next to excess work are
+ * disturbed.
+ */
+void nohz_pull_wrr(struct rq *rq)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	if (!rq->wrr.total_weight)
+		WRR_COST(WRR_COST_BALANCE,
+			 pull_busiest_wrr(rq, cpu_online_mask, LB_INTERVAL));
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/* Called from schedule() with rq locked when rq has nothing to run. */
+void idle_steal_wrr(struct rq *rq)
+{
+	if (sysctl_sched_wrr_cluster || sysctl_sched_wrr_steal)
+		WRR_COST(WRR_COST_BALANCE, __pull_wrr(rq));
+}
+
+void load_balance_wrr(struct rq *rq)
+{
+	if ((sysctl_sched_wrr_cluster || sysctl_sched_wrr_steal) &&
+	    !time_before(jiffies, rq->wrr.next_steal)) {
+		/*
+		 * An idle cpu pulls from schedule(); a busy one only tops
+		 * up now and then, or tasks would bounce around the cpus
+		 * faster than they get to run.
+		 */
+		rq->wrr.next_steal = jiffies + (sysctl_sched_wrr_cluster ?
+				WRR_CLUSTER_INTERVAL : WRR_STEAL_INTERVAL);
+		raw_spin_lock(&rq->lock);
+		WRR_COST(WRR_COST_BALANCE, __pull_wrr(rq));
+		raw_spin_unlock(&rq->lock);
+	}
+	if (!sysctl_sched_wrr_steal)
+		__load_balance_wrr(rq);
+}
+#endif
+
 static void task_tick_wrr(struct rq *rq, struct task_struct *p, int queued)
 {
+	update_home_node(rq, p);
 	update_curr(rq);
 }
 
@@ -241,6 +890,11 @@ static void task_fork_wrr(struct task_struct *p)
 	/* child weight is the same as parent's */
 	p->wrr.weight = p->real_parent->wrr.weight;
 	p->wrr.time_slice = p->wrr.weight * WRR_TIMESLICE;
+#ifdef CONFIG_NUMA
+	/* the copied address space still sits on the parent's node */
+	p->wrr.home_node = p->real_parent->wrr.home_node;
+	p->wrr.home_ticks = 0;
+#endif
 }
 
 static void switched_to_wrr(struct rq *rq, struct task_struct *p)
@@ -248,6 +902,10 @@ static void switched_to_wrr(struct rq *rq, struct task_struct *p)
 	/* sched policy switched from other to wrr */
 	p->wrr.weight = 10;
 	p->wrr.time_slice = 10 * WRR_TIMESLICE;
+#ifdef CONFIG_NUMA
+	p->wrr.home_node = cpu_to_node(task_cpu(p));
+	p->wrr.home_ticks = 0;
+#endif
 }
 
 static unsigned int get_rr_interval_wrr(struct rq *rq, struct task_struct *task)
@@ -0,0 +1,140 @@
+/*
+ * Migration cost calibration for the SCHED_WRR balancers
+ *
+ * A task moved to another cpu first runs slower while it refills the
+ * caches it left behind, and how much slower depends on what the two cpus
+ * share: an SMT sibling shares everything, a cpu of the same cluster the
+ * L2, a cpu of the same node only memory. pick_migrate_task_wrr() only
+ * moves a task when the cpu time it can expect to gain over the balancing
+ * interval exceeds wrr_migration_cost[] for the level of the move.
+ *
+ * The costs are measured once after boot, as the 2.6 migration_cost code
+ * did: a kthread dirties a buffer the size of the last level cache on one
+ * cpu, moves to a cpu at each level and times touching it again, against
+ * the time to touch it again in place. Levels this machine does not have
+ * keep a cost of 0.
+ *
+ * wrr_migration_cost=<smt>,<cluster>,<node>,<remote> (microseconds) on the
+ * kernel command line skips the measurement, and wrr_cache_size=<bytes>
+ * changes the buffer size (default 1MB).
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/cpu.h>
+#include <linux/vmalloc.h>
+#include <linux/cache.h>
+
+#include "sched.h"
+
+#define WRR_COST_REPS	5
+
+static unsigned long wrr_cache_size = 1024 * 1024;
+static bool wrr_cost_given;
+
+static const char * const wrr_level_names[WRR_NR_LEVELS] = {
+	[WRR_LEVEL_SMT]		= "smt",
+	[WRR_LEVEL_CLUSTER]	= "cluster",
+	[WRR_LEVEL_NODE]	= "node",
+	[WRR_LEVEL_REMOTE]	= "remote",
+};
+
+static int __init wrr_migration_cost_setup(char *str)
+{
+	int ints[WRR_NR_LEVELS + 1];
+	int i;
+
+	get_options(str, ARRAY_SIZE(ints), ints);
+	for (i = 0; i < ints[0]; i++)
+		wrr_migration_cost[i] = (u64)ints[i + 1] * NSEC_PER_USEC;
+	wrr_cost_given = true;
+	return 1;
+}
+__setup("wrr_migration_cost=", wrr_migration_cost_setup);
+
+static int __init wrr_cache_size_setup(char *str)
+{
+	wrr_cache_size = memparse(str, NULL);
+	return 1;
+}
+__setup("wrr_cache_size=", wrr_cache_size_setup);
+
+/* Write one word per cache line, so every line ends up dirty here. */
+static u64 wrr_touch(unsigned long *buf, unsigned long size)
+{
+	unsigned long i, step = L1_CACHE_BYTES / sizeof(*buf);
+	u64 start = sched_clock();
+
+	for (i = 0; i < size / sizeof(*buf); i += step)
+		buf[i]++;
+	return sched_clock() - start;
+}
+
+static int wrr_move_to(int cpu)
+{
+	return set_cpus_allowed_ptr(current, cpumask_of(cpu));
+}
+
+/*
+ * Cheapest of WRR_COST_REPS runs of (touch after moving from src to dst)
+ * minus (touch again on dst), so interrupts and other noise drop out.
+ */
+static u64 wrr_measure(unsigned long *buf, int src, int dst)
+{
+	u64 cold, hot, best = ULLONG_MAX;
+	int rep;
+
+	for (rep = 0; rep < WRR_COST_REPS; rep++) {
+		if (wrr_move_to(src))
+			return 0;
+		wrr_touch(buf, wrr_cache_size);
+		if (wrr_move_to(dst))
+			return 0;
+		cold = wrr_touch(buf, wrr_cache_size);
+		hot = wrr_touch(buf, wrr_cache_size);
+		best = min(best, cold > hot ? cold - hot : 0);
+	}
+	return best;
+}
+
+static int wrr_cost_fn(void *unused)
+{
+	unsigned long *buf;
+	int level, src, dst;
+
+	buf = vmalloc(wrr_cache_size);
+	if (!buf)
+		return -ENOMEM;
+
+	get_online_cpus();
+	src = cpumask_first(cpu_online_mask);
+	for (level = 0; level < WRR_NR_LEVELS; level++) {
+		for_each_online_cpu(dst)
+			if (dst != src && wrr_level(src, dst) == level)
+				break;
+		if (dst >= nr_cpu_ids)
+			continue;
+		wrr_migration_cost[level] = wrr_measure(buf, src, dst);
+	}
+	put_online_cpus();
+
+	vfree(buf);
+
+	for (level = 0; level < WRR_NR_LEVELS; level++)
+		pr_info("wrr: %s migration cost %llu ns\n",
+			wrr_level_names[level], wrr_migration_cost[level]);
+	return 0;
+}
+
+static int __init wrr_cost_init(void)
+{
+	struct task_struct *t;
+
+	if (wrr_cost_given || num_online_cpus() < 2)
+		return 0;
+
+	t = kthread_run(wrr_cost_fn, NULL, "wrr_cost");
+	return IS_ERR(t) ? PTR_ERR(t) : 0;
+}
+late_initcall(wrr_cost_init);
@@ -0,0 +1,351 @@
+/*
+ * Boot-time self-test and microbenchmark for the SCHED_WRR class
+ *
+ * A control kthread runs three phases after boot:
+ *
+ *  share:  for each weight mix, one worker per weight is bound to the last
+ *          online cpu and spins for share_secs. The loops each worker got
+ *          through are compared with weight / total weight.
+ *  stress: nworkers unbound workers with random weights, while the control
+ *          thread reweights them, shuffles their affinity and (optionally)
+ *          takes cpus offline and back. Every few ms each wrr_rq is checked:
+ *          total_weight must equal the weight of the queued entities and
+ *          the cursor must be NULL exactly when the queue is empty and
+ *          otherwise point at a queued entity.
+ *  cost:   average cycles spent in enqueue, dequeue, pick_next and
+ *          load_balance_wrr over the whole run.
+ *
+ * Parameters are given on the kernel command line, e.g.
+ * wrr_selftest.stress_secs=60 wrr_selftest.onoff_interval=500. The result
+ * line "wrr_selftest: End of test: SUCCESS" (or FAILURE) is meant to be
+ * grepped for by a QEMU boot script.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/math64.h>
+#include <linux/cpu.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/stat.h>
+
+#include "sched.h"
+
+static int share_secs = 10;	/* Duration of each share test, seconds. */
+static int share_tolerance = 5;	/* Allowed share error, percent. */
+static int stress_secs = 30;	/* Duration of the stress phase, seconds. */
+static int nworkers = -1;	/* # stress workers, defaults to 2*ncpus */
+static int reweight_interval = 10;	/* ms between reweights, 0=disable */
+static int shuffle_interval = 50;	/* ms between affinity changes, 0=disable */
+static int onoff_interval;	/* ms between cpu hotplugs, 0=disable */
+
+module_param(share_secs, int, 0444);
+MODULE_PARM_DESC(share_secs, "Duration of each share test (s)");
+module_param(share_tolerance, int, 0444);
+MODULE_PARM_DESC(share_tolerance, "Allowed share error (percent)");
+module_param(stress_secs, int, 0444);
+MODULE_PARM_DESC(stress_secs, "Duration of the stress phase (s)");
+module_param(nworkers, int, 0444);
+MODULE_PARM_DESC(nworkers, "Number of stress workers");
+module_param(reweight_interval, int, 0444);
+MODULE_PARM_DESC(reweight_interval, "Time between reweights (ms), 0=disable");
+module_param(shuffle_interval, int, 0444);
+MODULE_PARM_DESC(shuffle_interval, "Time between affinity changes (ms), 0=disable");
+module_param(onoff_interval, int, 0444);
+MODULE_PARM_DESC(onoff_interval, "Time between CPU hotplugs (ms), 0=disable");
+
+#define WRR_ST_FLAG "wrr_selftest: "
+#define WRR_ST_CHECK_MS		5
+#define WRR_ST_MAX_REPORTS	10
+
+struct wrr_st_worker {
+	struct task_struct *task;
+	unsigned long loops;
+	unsigned int weight;
+};
+
+static const unsigned int share_mixes[][5] = {
+	{ 1, 2, 4, 8 },
+	{ 1, 20 },
+	{ 5, 10, 15, 20 },
+	{ 10, 10, 10 },
+};
+
+static unsigned long n_errors;
+
+static int wrr_st_worker_fn(void *arg)
+{
+	struct wrr_st_worker *w = arg;
+
+	while (!kthread_should_stop()) {
+		w->loops++;
+		cond_resched();
+	}
+	return 0;
+}
+
+static int wrr_st_spawn(struct wrr_st_worker *w, int cpu, int id)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	struct task_struct *t;
+
+	t = kthread_create(wrr_st_worker_fn, w, "wrr_st/%d", id);
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+
+	if (cpu >= 0)
+		kthread_bind(t, cpu);
+	sched_setscheduler_nocheck(t, SCHED_WRR, &param);
+	sched_set_wrr_weight(t, w->weight);
+	w->loops = 0;
+	w->task = t;
+	wake_up_process(t);
+	return 0;
+}
+
+static void wrr_st_stop(struct wrr_st_worker *workers, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (workers[i].task)
+			kthread_stop(workers[i].task);
+		workers[i].task = NULL;
+	}
+}
+
+static void wrr_st_share(const unsigned int *mix, int cpu)
+{
+	struct wrr_st_worker workers[ARRAY_SIZE(share_mixes[0])];
+	unsigned long total_loops = 0, total_weight = 0;
+	int i, n, err, max_err = 0;
+
+	memset(workers, 0, sizeof(workers));
+	for (n = 0; n < ARRAY_SIZE(workers) && mix[n]; n++) {
+		workers[n].weight = mix[n];
+		total_weight += mix[n];
+		if (wrr_st_spawn(&workers[n], cpu, n)) {
+			pr_alert(WRR_ST_FLAG "cannot create share worker\n");
+			n_errors++;
+			wrr_st_stop(workers, n);
+			return;
+		}
+	}
+
+	schedule_timeout_interruptible(share_secs * HZ);
+	wrr_st_stop(workers, n);
+
+	for (i = 0; i < n; i++)
+		total_loops += workers[i].loops;
+	if (!total_loops) {
+		pr_alert(WRR_ST_FLAG "share workers never ran\n");
+		n_errors++;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		int expected = mult_frac(workers[i].weight, 1000, total_weight);
+		int achieved = mult_frac(workers[i].loops, 1000, total_loops);
+
+		pr_info(WRR_ST_FLAG "cpu %d weight %2u: expected %3d.%d%% achieved %3d.%d%%\n",
+			cpu, workers[i].weight, expected / 10, expected % 10,
+			achieved / 10, achieved % 10);
+		err = abs(achieved - expected);
+		max_err = max(max_err, err);
+	}
+
+	if (max_err > share_tolerance * 10) {
+		pr_alert(WRR_ST_FLAG "share error %d.%d%% above %d%%\n",
+			 max_err / 10, max_err % 10, share_tolerance);
+		n_errors++;
+	}
+}
+
+static void wrr_st_check(void)
+{
+	struct sched_wrr_entity *se;
+	unsigned long flags, weight;
+	bool cursor_ok, empty;
+	struct rq *rq;
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		rq = cpu_rq(cpu);
+		raw_spin_lock_irqsave(&rq->lock, flags);
+		raw_spin_lock(&rq->wrr.lock);
+
+		weight = 0;
+		cursor_ok = false;
+		list_for_each_entry(se, &rq->wrr.run_queue, run_list) {
+			weight += se->weight;
+			if (rq->wrr.curr && se == &rq->wrr.curr->wrr)
+				cursor_ok = true;
+		}
+		empty = list_empty(&rq->wrr.run_queue);
+		if (empty)
+			cursor_ok = !rq->wrr.curr;
+
+		if ((weight != rq->wrr.total_weight || !cursor_ok) &&
+		    ++n_errors <= WRR_ST_MAX_REPORTS)
+			pr_alert(WRR_ST_FLAG "cpu %d: total_weight %lu, queued weight %lu, cursor %s\n",
+				 cpu, rq->wrr.total_weight, weight,
+				 cursor_ok ? "valid" : "invalid");
+
+		raw_spin_unlock(&rq->wrr.lock);
+		raw_spin_unlock_irqrestore(&rq->lock, flags);
+	}
+	put_online_cpus();
+}
+
+static int wrr_st_random_cpu(void)
+{
+	int cpu, n = prandom_u32() % num_online_cpus();
+
+	for_each_online_cpu(cpu)
+		if (!n--)
+			return cpu;
+	return cpumask_first(cpu_online_mask);
+}
+
+static void wrr_st_hotplug(void)
+{
+#ifdef CONFIG_HOTPLUG_CPU
+	int cpu = prandom_u32() % nr_cpu_ids;
+
+	/* the boot cpu cannot go away on every architecture */
+	if (!cpu || !cpu_present(cpu))
+		return;
+	if (cpu_online(cpu))
+		cpu_down(cpu);
+	else
+		cpu_up(cpu);
+#endif
+}
+
+static void wrr_st_stress(void)
+{
+	unsigned long end, next_check, next_reweight, next_shuffle, next_onoff;
+	struct wrr_st_worker *workers, *w;
+	int i, n;
+
+	n = nworkers > 0 ? nworkers : 2 * num_online_cpus();
+	workers = kcalloc(n, sizeof(*workers), GFP_KERNEL);
+	if (!workers) {
+		pr_alert(WRR_ST_FLAG "out of memory\n");
+		n_errors++;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		workers[i].weight = 1 + prandom_u32() % 20;
+		if (wrr_st_spawn(&workers[i], -1, i)) {
+			pr_alert(WRR_ST_FLAG "cannot create stress worker\n");
+			n_errors++;
+			n = i;
+			goto out;
+		}
+	}
+
+	end = jiffies + stress_secs * HZ;
+	next_check = next_reweight = next_shuffle = next_onoff = jiffies;
+
+	while (time_before(jiffies, end)) {
+		w = &workers[prandom_u32() % n];
+
+		if (reweight_interval && time_after_eq(jiffies, next_reweight)) {
+			sched_set_wrr_weight(w->task, 1 + prandom_u32() % 20);
+			next_reweight = jiffies + msecs_to_jiffies(reweight_interval);
+		}
+		if (shuffle_interval && time_after_eq(jiffies, next_shuffle)) {
+			if (prandom_u32() & 1)
+				set_cpus_allowed_ptr(w->task,
+						     cpumask_of(wrr_st_random_cpu()));
+			else
+				set_cpus_allowed_ptr(w->task, cpu_online_mask);
+			next_shuffle = jiffies + msecs_to_jiffies(shuffle_interval);
+		}
+		if (onoff_interval && time_after_eq(jiffies, next_onoff)) {
+			wrr_st_hotplug();
+			next_onoff = jiffies + msecs_to_jiffies(onoff_interval);
+		}
+		if (time_after_eq(jiffies, next_check)) {
+			wrr_st_check();
+			next_check = jiffies + msecs_to_jiffies(WRR_ST_CHECK_MS);
+		}
+		schedule_timeout_interruptible(1);
+	}
+
+out:
+	wrr_st_stop(workers, n);
+	kfree(workers);
+
+#ifdef CONFIG_HOTPLUG_CPU
+	for_each_present_cpu(i)
+		if (!cpu_online(i))
+			cpu_up(i);
+#endif
+	/* the queues must be consistent again once the workers are gone */
+	wrr_st_check();
+}
+
+static void wrr_st_report_cost(void)
+{
+	static const char * const names[NR_WRR_COST] = {
+		[WRR_COST_ENQUEUE]	= "enqueue",
+		[WRR_COST_DEQUEUE]	= "dequeue",
+		[WRR_COST_PICK]		= "pick_next",
+		[WRR_COST_BALANCE]	= "load_balance",
+	};
+	u64 cycles;
+	unsigned long count;
+	int op, cpu;
+
+	for (op = 0; op < NR_WRR_COST; op++) {
+		cycles = 0;
+		count = 0;
+		for_each_possible_cpu(cpu) {
+			cycles += per_cpu(wrr_cost, cpu).cycles[op];
+			count += per_cpu(wrr_cost, cpu).count[op];
+		}
+		if (count)
+			do_div(cycles, count);
+		pr_info(WRR_ST_FLAG "%-12s %6llu cycles/call (%lu calls)\n",
+			names[op], (unsigned long long)cycles, count);
+	}
+}
+
+static int wrr_st_control(void *unused)
+{
+	int i, cpu = cpumask_last(cpu_online_mask);
+
+	pr_alert(WRR_ST_FLAG "Start of test: share_secs=%d stress_secs=%d nworkers=%d reweight_interval=%d shuffle_interval=%d onoff_interval=%d\n",
+		 share_secs, stress_secs, nworkers, reweight_interval,
+		 shuffle_interval, onoff_interval);
+
+	for (i = 0; i < ARRAY_SIZE(share_mixes); i++)
+		wrr_st_share(share_mixes[i], cpu);
+	wrr_st_stress();
+	wrr_st_report_cost();
+
+	pr_alert(WRR_ST_FLAG "End of test: %s (%lu errors)\n",
+		 n_errors ? "FAILURE" : "SUCCESS", n_errors);
+	return 0;
+}
+
+static int __init wrr_selftest_init(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(wrr_st_control, NULL, "wrr_selftest");
+	if (IS_ERR(t)) {
+		pr_alert(WRR_ST_FLAG "cannot start: %ld\n", PTR_ERR(t));
+		return PTR_ERR(t);
+	}
+	return 0;
+}
+late_initcall(wrr_selftest_init);
@@ -66,6 +66,10 @@
 #include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/shrinker.h>
+#include <linux/jiffies.h>
 #include <linux/zsmalloc.h>
 
 /*
@@ -172,14 +176,12 @@ enum zs_stat_type {
 	NR_ZS_STAT_TYPE,
 };
 
-#ifdef CONFIG_ZSMALLOC_STAT
-
-static struct dentry *zs_stat_root;
-
 struct zs_size_stat {
 	unsigned long objs[NR_ZS_STAT_TYPE];
 };
 
+#ifdef CONFIG_ZSMALLOC_STAT
+static struct dentry *zs_stat_root;
 #endif
 
 /*
@@ -216,9 +218,8 @@ struct size_class {
 	/* huge object: pages_per_zspage == 1 && maxobj_per_zspage == 1 */
 	bool huge;
 
-#ifdef CONFIG_ZSMALLOC_STAT
+	/* kept under lock, read without it to estimate compaction gains */
 	struct zs_size_stat stats;
-#endif
 
 	spinlock_t lock;
 
@@ -254,6 +255,15 @@ struct zs_pool {
 	gfp_t flags;	/* allocation flags used when growing pool */
 	atomic_long_t pages_allocated;
 
+	atomic_long_t pages_compacted;	/* zspage pages freed by compaction */
+	atomic64_t compact_ns;		/* time spent in zs_compact() */
+
+	/* background compaction, see zs_compactd() */
+	struct shrinker shrinker;
+	struct list_head compact_list;	/* on zs_compact_pools */
+	bool compact_force;		/* compact below the watermark too */
+	unsigned long compact_next;	/* jiffies of the next watermark check */
+
 #ifdef CONFIG_ZSMALLOC_STAT
 	struct dentry *stat_dentry;
 #endif
@@ -291,10 +301,10 @@ static void destroy_handle_cache(struct zs_pool *pool)
 	kmem_cache_destroy(pool->handle_cachep);
 }
 
-static unsigned long alloc_handle(struct zs_pool *pool)
+static unsigned long alloc_handle(struct zs_pool *pool, gfp_t gfp)
 {
 	return (unsigned long)kmem_cache_alloc(pool->handle_cachep,
-		pool->flags & ~__GFP_HIGHMEM);
+		gfp & ~__GFP_HIGHMEM);
 }
 
 static void free_handle(struct zs_pool *pool, unsigned long handle)
@@ -442,8 +452,6 @@ static int get_size_class_index(int size)
 	return min(zs_size_classes - 1, idx);
 }
 
-#ifdef CONFIG_ZSMALLOC_STAT
-
 static inline void zs_stat_inc(struct size_class *class,
 				enum zs_stat_type type, unsigned long cnt)
 {
@@ -462,6 +470,8 @@ static inline unsigned long zs_stat_get(struct size_class *class,
 	return class->stats.objs[type];
 }
 
+#ifdef CONFIG_ZSMALLOC_STAT
+
 static int __init zs_stat_init(void)
 {
 	if (!debugfs_initialized())
@@ -578,22 +588,6 @@ static void zs_pool_stat_destroy(struct zs_pool *pool)
 
 #else /* CONFIG_ZSMALLOC_STAT */
 
-static inline void zs_stat_inc(struct size_class *class,
-				enum zs_stat_type type, unsigned long cnt)
-{
-}
-
-static inline void zs_stat_dec(struct size_class *class,
-				enum zs_stat_type type, unsigned long cnt)
-{
-}
-
-static inline unsigned long zs_stat_get(struct size_class *class,
-				enum zs_stat_type type)
-{
-	return 0;
-}
-
 static int __init zs_stat_init(void)
 {
 	return 0;
@@ -1366,15 +1360,17 @@ static unsigned long obj_malloc(struct page *first_page,
 
 
 /**
- * zs_malloc - Allocate block of given size from pool.
+ * zs_malloc_gfp - Allocate block of given size from pool.
  * @pool: pool to allocate from
  * @size: size of block to allocate
+ * @gfp: flags for any pages the pool has to grow by, in place of the
+ *	 flags the pool was created with
  *
  * On success, handle to the allocated object is returned,
  * otherwise 0.
  * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
  */
-unsigned long zs_malloc(struct zs_pool *pool, size_t size)
+unsigned long zs_malloc_gfp(struct zs_pool *pool, size_t size, gfp_t gfp)
 {
 	unsigned long handle, obj;
 	struct size_class *class;
@@ -1383,7 +1379,7 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return 0;
 
-	handle = alloc_handle(pool);
+	handle = alloc_handle(pool, gfp);
 	if (!handle)
 		return 0;
 
@@ -1396,7 +1392,7 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 
 	if (!first_page) {
 		spin_unlock(&class->lock);
-		first_page = alloc_zspage(class, pool->flags);
+		first_page = alloc_zspage(class, gfp);
 		if (unlikely(!first_page)) {
 			free_handle(pool, handle);
 			return 0;
@@ -1419,6 +1415,19 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 
 	return handle;
 }
+EXPORT_SYMBOL_GPL(zs_malloc_gfp);
+
+/**
+ * zs_malloc - Allocate block of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of block to allocate
+ *
+ * As zs_malloc_gfp() with the flags the pool was created with.
+ */
+unsigned long zs_malloc(struct zs_pool *pool, size_t size)
+{
+	return zs_malloc_gfp(pool, size, pool->flags);
+}
 EXPORT_SYMBOL_GPL(zs_malloc);
 
 static void obj_free(struct zs_pool *pool, struct size_class *class,
@@ -1453,6 +1462,45 @@ static void obj_free(struct zs_pool *pool, struct size_class *class,
 	zs_stat_dec(class, OBJ_USED, 1);
 }
 
+/*
+ * Background compaction: zs_compactd compacts a pool when the pages
+ * compaction could free reach zs_compact_watermark percent of the pool,
+ * checked at most every zs_compact_interval_ms as objects are freed, or
+ * when the pool's shrinker is asked to scan. It runs at the lowest
+ * priority and sleeps zs_compact_interval_ms after each pass.
+ */
+static unsigned int zs_compact_watermark = 25;
+module_param_named(compact_watermark, zs_compact_watermark, uint,
+		   S_IRUGO | S_IWUSR);
+static unsigned int zs_compact_interval_ms = 1000;
+module_param_named(compact_interval_ms, zs_compact_interval_ms, uint,
+		   S_IRUGO | S_IWUSR);
+
+/* not worth waking up for less */
+#define ZS_COMPACT_MIN_PAGES	32
+
+static struct task_struct *zs_compactd_task;
+static LIST_HEAD(zs_compact_pools);
+static DEFINE_SPINLOCK(zs_compact_lock);
+/* held while a pool is compacted, so it cannot be destroyed meanwhile */
+static DEFINE_MUTEX(zs_compact_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(zs_compact_wait);
+
+static void zs_compact_kick(struct zs_pool *pool, bool force)
+{
+	unsigned long flags;
+
+	pool->compact_next = jiffies + msecs_to_jiffies(zs_compact_interval_ms);
+
+	spin_lock_irqsave(&zs_compact_lock, flags);
+	if (list_empty(&pool->compact_list))
+		list_add_tail(&pool->compact_list, &zs_compact_pools);
+	pool->compact_force |= force;
+	spin_unlock_irqrestore(&zs_compact_lock, flags);
+
+	wake_up(&zs_compact_wait);
+}
+
 void zs_free(struct zs_pool *pool, unsigned long handle)
 {
 	struct page *first_page, *f_page;
@@ -1486,6 +1534,10 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	unpin_tag(handle);
 
 	free_handle(pool, handle);
+
+	if (zs_compact_watermark &&
+	    time_after_eq(jiffies, ACCESS_ONCE(pool->compact_next)))
+		zs_compact_kick(pool, false);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
@@ -1679,6 +1731,8 @@ static void putback_zspage(struct zs_pool *pool, struct size_class *class,
 			class->size, class->pages_per_zspage));
 		atomic_long_sub(class->pages_per_zspage,
 				&pool->pages_allocated);
+		atomic_long_add(class->pages_per_zspage,
+				&pool->pages_compacted);
 
 		free_zspage(first_page);
 	}
@@ -1755,6 +1809,7 @@ unsigned long zs_compact(struct zs_pool *pool)
 	int i;
 	unsigned long nr_migrated = 0;
 	struct size_class *class;
+	u64 start = local_clock();
 
 	for (i = zs_size_classes - 1; i >= 0; i--) {
 		class = pool->size_class[i];
@@ -1767,10 +1822,111 @@ unsigned long zs_compact(struct zs_pool *pool)
 
 	synchronize_rcu();
 
+	atomic64_add(local_clock() - start, &pool->compact_ns);
 	return nr_migrated;
 }
 EXPORT_SYMBOL_GPL(zs_compact);
 
+void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
+{
+	stats->pages_compacted = atomic_long_read(&pool->pages_compacted);
+	stats->compact_ns = atomic64_read(&pool->compact_ns);
+}
+EXPORT_SYMBOL_GPL(zs_pool_stats);
+
+/* Pages compaction could free in class, from its unlocked stats. */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_allocated, obj_used;
+
+	obj_allocated = zs_stat_get(class, OBJ_ALLOCATED);
+	obj_used = zs_stat_get(class, OBJ_USED);
+	if (obj_allocated <= obj_used)
+		return 0;
+
+	return (obj_allocated - obj_used) /
+		get_maxobj_per_zspage(class->size, class->pages_per_zspage) *
+		class->pages_per_zspage;
+}
+
+static unsigned long zs_compactable_pages(struct zs_pool *pool)
+{
+	unsigned long pages = 0;
+	struct size_class *class;
+	int i;
+
+	for (i = 0; i < zs_size_classes; i++) {
+		class = pool->size_class[i];
+		if (class && class->index == i)
+			pages += zs_can_compact(class);
+	}
+	return pages;
+}
+
+static bool zs_over_watermark(struct zs_pool *pool)
+{
+	unsigned long pages = zs_compactable_pages(pool);
+
+	return zs_compact_watermark && pages >= ZS_COMPACT_MIN_PAGES &&
+		pages * 100 >= atomic_long_read(&pool->pages_allocated) *
+			       zs_compact_watermark;
+}
+
+/*
+ * Reclaim only wakes zs_compactd: compacting here would hold up the
+ * allocation that is reclaiming, and can't be done in every context.
+ */
+static int zs_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					    shrinker);
+	unsigned long pages = zs_compactable_pages(pool);
+
+	if (sc->nr_to_scan && pages)
+		zs_compact_kick(pool, true);
+
+	return min_t(unsigned long, pages, INT_MAX);
+}
+
+static int zs_compactd(void *unused)
+{
+	struct zs_pool *pool;
+	bool force, compacted;
+
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(zs_compact_wait,
+				     !list_empty(&zs_compact_pools) ||
+				     kthread_should_stop());
+
+		compacted = force = false;
+		mutex_lock(&zs_compact_mutex);
+		spin_lock_irq(&zs_compact_lock);
+		pool = list_first_entry_or_null(&zs_compact_pools,
+						 struct zs_pool, compact_list);
+		if (pool) {
+			list_del_init(&pool->compact_list);
+			force = pool->compact_force;
+			pool->compact_force = false;
+		}
+		spin_unlock_irq(&zs_compact_lock);
+
+		if (pool && (force || zs_over_watermark(pool))) {
+			zs_compact(pool);
+			compacted = true;
+		}
+		mutex_unlock(&zs_compact_mutex);
+
+		/* rate limit: requests meanwhile are served after this */
+		if (compacted)
+			schedule_timeout_interruptible(
+				msecs_to_jiffies(zs_compact_interval_ms));
+	}
+	return 0;
+}
+
 /**
  * zs_create_pool - Creates an allocation pool to work from.
  * @flags: allocation flags used to allocate pool metadata
@@ -1790,6 +1946,7 @@ struct zs_pool *zs_create_pool(char *name, gfp_t flags)
 	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
 	if (!pool)
 		return NULL;
+	INIT_LIST_HEAD(&pool->compact_list);
 
 	pool->size_class = kcalloc(zs_size_classes, sizeof(struct size_class *),
 			GFP_KERNEL);
@@ -1856,6 +2013,11 @@ struct zs_pool *zs_create_pool(char *name, gfp_t flags)
 	if (zs_pool_stat_create(name, pool))
 		goto err;
 
+	pool->compact_next = jiffies;
+	pool->shrinker.shrink = zs_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+
 	return pool;
 
 err:
@@ -1868,6 +2030,14 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	if (pool->shrinker.shrink)
+		unregister_shrinker(&pool->shrinker);
+	mutex_lock(&zs_compact_mutex);
+	spin_lock_irq(&zs_compact_lock);
+	list_del_init(&pool->compact_list);
+	spin_unlock_irq(&zs_compact_lock);
+	mutex_unlock(&zs_compact_mutex);
+
 	zs_pool_stat_destroy(pool);
 
 	for (i = 0; i < zs_size_classes; i++) {
@@ -1914,6 +2084,13 @@ static int __init zs_init(void)
 		pr_err("zs stat initialization failed\n");
 		goto stat_fail;
 	}
+
+	/* pools still compact on demand without it */
+	zs_compactd_task = kthread_run(zs_compactd, NULL, "zs_compactd");
+	if (IS_ERR(zs_compactd_task)) {
+		pr_warn("zs_compactd failed to start\n");
+		zs_compactd_task = NULL;
+	}
 	return 0;
 
 stat_fail:
@@ -1928,6 +2105,8 @@ notifier_fail:
 
 static void __exit zs_exit(void)
 {
+	if (zs_compactd_task)
+		kthread_stop(zs_compactd_task);
 #ifdef CONFIG_ZPOOL
 	zpool_unregister_driver(&zs_zpool_driver);
 #endif
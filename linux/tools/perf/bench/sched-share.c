@@ -0,0 +1,240 @@
+/*
+ *
+ * sched-share.c
+ *
+ * share: CPU share achieved by tasks of one policy and varied weights
+ *
+ * Every task is pinned to the same CPU and spins for the whole run. The
+ * CPU time each one received is compared against its expected share,
+ * weight / sum of weights for SCHED_WRR and an equal split otherwise.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define MAX_TASKS	64
+#define MAX_WEIGHT	20
+
+static const char *policy_str = "wrr";
+static const char *weights_str = "1,5,10,20";
+static int cpu;
+static int runtime = 5;
+
+static const struct option options[] = {
+	OPT_STRING('p', "policy", &policy_str, "policy",
+		   "Scheduling policy: wrr, normal or rr"),
+	OPT_STRING('w', "weights", &weights_str, "w1,w2,...",
+		   "Spawn one task per SCHED_WRR weight (1..20)"),
+	OPT_INTEGER('c', "cpu", &cpu, "CPU to run all tasks on"),
+	OPT_INTEGER('r', "runtime", &runtime, "Runtime in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_sched_share_usage[] = {
+	"perf bench sched share <options>",
+	NULL
+};
+
+struct share_ctl {
+	volatile int start;
+	volatile int stop;
+	volatile int ready;
+	volatile int failed;	/* tasks whose policy or weight was refused */
+};
+
+int bench_sched_parse_policy(const char *str)
+{
+	if (!strcmp(str, "wrr"))
+		return SCHED_WRR;
+	if (!strcmp(str, "normal"))
+		return SCHED_OTHER;
+	if (!strcmp(str, "rr"))
+		return SCHED_RR;
+	return -1;
+}
+
+/* Switch the calling task to 'policy' (and 'weight' for SCHED_WRR) on 'cpu' */
+int bench_sched_setup(int policy, int weight, int cpu)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	cpu_set_t mask;
+
+	if (cpu >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET(cpu, &mask);
+		if (sched_setaffinity(0, sizeof(mask), &mask))
+			return -errno;
+	}
+
+	if (policy == SCHED_RR)
+		param.sched_priority = 1;
+	if (sched_setscheduler(0, policy, &param))
+		return -errno;
+
+	if (policy != SCHED_WRR)
+		return 0;
+#ifdef __NR_sched_setweight
+	if (syscall(__NR_sched_setweight, 0, weight))
+		return -errno;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+static int parse_weights(const char *str, int *weights)
+{
+	int nr = 0;
+	char *end;
+	long w;
+
+	while (*str && nr < MAX_TASKS) {
+		w = strtol(str, &end, 10);
+		if (end == str || w < 1 || w > MAX_WEIGHT)
+			return -1;
+		weights[nr++] = w;
+		str = *end == ',' ? end + 1 : end;
+		if (*end && *end != ',')
+			return -1;
+	}
+	return *str ? -1 : nr;
+}
+
+static void NORETURN share_task(struct share_ctl *ctl, int policy,
+				int weight)
+{
+	int err = bench_sched_setup(policy, weight, cpu);
+
+	if (err) {
+		fprintf(stderr, "task with weight %d: %s\n", weight,
+			strerror(-err));
+		__sync_fetch_and_add(&ctl->failed, 1);
+	}
+	__sync_fetch_and_add(&ctl->ready, 1);
+
+	while (!ctl->start)
+		cpu_relax();
+	while (!ctl->stop)
+		;
+	exit(0);
+}
+
+int bench_sched_share(int argc, const char **argv,
+		      const char *prefix __maybe_unused)
+{
+	int weights[MAX_TASKS];
+	pid_t pids[MAX_TASKS];
+	double cpu_time[MAX_TASKS];
+	struct share_ctl *ctl;
+	struct rusage ru;
+	double total = 0, max_err = 0;
+	int total_weight = 0;
+	int policy, nr, i;
+
+	argc = parse_options(argc, argv, options, bench_sched_share_usage, 0);
+
+	policy = bench_sched_parse_policy(policy_str);
+	if (policy < 0) {
+		fprintf(stderr, "Unknown policy:%s\n", policy_str);
+		usage_with_options(bench_sched_share_usage, options);
+	}
+
+	nr = parse_weights(weights_str, weights);
+	if (nr < 1) {
+		fprintf(stderr, "Invalid weights:%s\n", weights_str);
+		usage_with_options(bench_sched_share_usage, options);
+	}
+
+	ctl = mmap(NULL, sizeof(*ctl), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	BUG_ON(ctl == MAP_FAILED);
+	memset(ctl, 0, sizeof(*ctl));
+
+	for (i = 0; i < nr; i++) {
+		pids[i] = fork();
+		BUG_ON(pids[i] < 0);
+		if (!pids[i])
+			share_task(ctl, policy, weights[i]);
+		total_weight += weights[i];
+	}
+
+	while (ctl->ready < nr)
+		usleep(1000);
+	if (ctl->failed) {
+		/* the expected shares assume every weight was applied */
+		ctl->start = 1;
+		ctl->stop = 1;
+		for (i = 0; i < nr; i++)
+			waitpid(pids[i], NULL, 0);
+		munmap(ctl, sizeof(*ctl));
+		return 1;
+	}
+	ctl->start = 1;
+	sleep(runtime);
+	ctl->stop = 1;
+
+	for (i = 0; i < nr; i++) {
+		if (wait4(pids[i], NULL, 0, &ru) != pids[i]) {
+			perror("wait4");
+			exit(1);
+		}
+		cpu_time[i] = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+			(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+		total += cpu_time[i];
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d tasks on CPU %d, policy %s, %d sec\n\n",
+		       nr, cpu, policy_str, runtime);
+
+	for (i = 0; i < nr; i++) {
+		double expected, achieved, err;
+
+		if (policy == SCHED_WRR)
+			expected = 100.0 * weights[i] / total_weight;
+		else
+			expected = 100.0 / nr;
+		achieved = total ? 100.0 * cpu_time[i] / total : 0;
+		err = achieved > expected ? achieved - expected :
+			expected - achieved;
+		if (err > max_err)
+			max_err = err;
+
+		if (bench_format == BENCH_FORMAT_DEFAULT)
+			printf(" task %3d weight %2d: expected %6.2f%%, achieved %6.2f%% (%.2f sec)\n",
+			       i, weights[i], expected, achieved, cpu_time[i]);
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("\n %14s: %.2f%%\n", "Max share error", max_err);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.2f\n", max_err);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	munmap(ctl, sizeof(*ctl));
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ *
+ * sched-wakeup.c
+ *
+ * wakeup: wakeup latency percentiles under background load
+ *
+ * A waker stamps the time and writes to a pipe; the wakee, blocked in
+ * read(), stamps the time it actually got to run. Both run on the same
+ * CPU as a configurable number of spinners of the same policy.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_LOAD	64
+
+static const char *policy_str = "wrr";
+static int nr_load = 2;
+static int loops = 10000;
+static int cpu;
+static int weight = 10;
+
+static const struct option options[] = {
+	OPT_STRING('p', "policy", &policy_str, "policy",
+		   "Scheduling policy: wrr, normal or rr"),
+	OPT_INTEGER('L', "load", &nr_load, "Number of background spinners"),
+	OPT_INTEGER('l', "loop", &loops, "Specify number of wakeups"),
+	OPT_INTEGER('c', "cpu", &cpu, "CPU to run on, -1 for any"),
+	OPT_INTEGER('w', "weight", &weight, "SCHED_WRR weight of every task"),
+	OPT_END()
+};
+
+static const char * const bench_sched_wakeup_usage[] = {
+	"perf bench sched wakeup <options>",
+	NULL
+};
+
+struct wakeup_ctl {
+	volatile u64 sent;
+	u64 lat[];
+};
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double pct(u64 *sorted, int nr, double p)
+{
+	return sorted[(int)(p / 100.0 * (nr - 1))] / 1000.0;
+}
+
+static void setup_or_die(int policy)
+{
+	int err = bench_sched_setup(policy, weight, cpu);
+
+	if (err) {
+		fprintf(stderr, "setting policy %s: %s\n", policy_str,
+			strerror(-err));
+		exit(1);
+	}
+}
+
+static void kill_load(pid_t *load, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		kill(load[i], SIGKILL);
+	for (i = 0; i < nr; i++)
+		waitpid(load[i], NULL, 0);
+}
+
+int bench_sched_wakeup(int argc, const char **argv,
+		       const char *prefix __maybe_unused)
+{
+	pid_t load[MAX_LOAD];
+	struct wakeup_ctl *ctl;
+	size_t size;
+	int wake[2], ack[2];
+	pid_t wakee;
+	int policy, i, err;
+	char c = 0;
+
+	argc = parse_options(argc, argv, options, bench_sched_wakeup_usage, 0);
+
+	policy = bench_sched_parse_policy(policy_str);
+	if (policy < 0 || nr_load < 0 || nr_load > MAX_LOAD || loops < 1)
+		usage_with_options(bench_sched_wakeup_usage, options);
+
+	size = sizeof(*ctl) + loops * sizeof(u64);
+	ctl = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	BUG_ON(ctl == MAP_FAILED);
+
+	if (pipe(wake) || pipe(ack)) {
+		perror("pipe");
+		exit(1);
+	}
+
+	for (i = 0; i < nr_load; i++) {
+		load[i] = fork();
+		BUG_ON(load[i] < 0);
+		if (!load[i]) {
+			setup_or_die(policy);
+			for (;;)
+				;
+		}
+	}
+
+	wakee = fork();
+	BUG_ON(wakee < 0);
+	if (!wakee) {
+		close(wake[1]);
+		close(ack[0]);
+		setup_or_die(policy);
+		for (i = 0; i < loops; i++) {
+			if (read(wake[0], &c, 1) != 1)
+				exit(1);
+			ctl->lat[i] = now_ns() - ctl->sent;
+			if (write(ack[1], &c, 1) != 1)
+				exit(1);
+		}
+		exit(0);
+	}
+
+	close(wake[0]);
+	close(ack[1]);
+	/* a wakee that died makes the write fail instead of killing us */
+	signal(SIGPIPE, SIG_IGN);
+
+	err = bench_sched_setup(policy, weight, cpu);
+	if (err) {
+		fprintf(stderr, "setting policy %s: %s\n", policy_str,
+			strerror(-err));
+		i = 0;
+	} else {
+		for (i = 0; i < loops; i++) {
+			ctl->sent = now_ns();
+			if (write(wake[1], &c, 1) != 1 ||
+			    read(ack[0], &c, 1) != 1) {
+				perror("pipe");
+				break;
+			}
+		}
+	}
+	loops = i;
+
+	/*
+	 * The spinners hold copies of the pipe too: once they are gone, a
+	 * wakee still waiting for a wakeup sees EOF and exits.
+	 */
+	close(wake[1]);
+	close(ack[0]);
+	kill_load(load, nr_load);
+	waitpid(wakee, NULL, 0);
+	if (!loops) {
+		munmap(ctl, size);
+		return 1;
+	}
+
+	qsort(ctl->lat, loops, sizeof(u64), cmp_u64);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d wakeups on CPU %d, policy %s, %d background spinners\n\n",
+		       loops, cpu, policy_str, nr_load);
+		printf(" %14s: %.1f usecs\n", "p50", pct(ctl->lat, loops, 50));
+		printf(" %14s: %.1f usecs\n", "p90", pct(ctl->lat, loops, 90));
+		printf(" %14s: %.1f usecs\n", "p99", pct(ctl->lat, loops, 99));
+		printf(" %14s: %.1f usecs\n", "p99.9", pct(ctl->lat, loops, 99.9));
+		printf(" %14s: %.1f usecs\n", "max", pct(ctl->lat, loops, 100));
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1f %.1f %.1f %.1f %.1f\n",
+		       pct(ctl->lat, loops, 50), pct(ctl->lat, loops, 90),
+		       pct(ctl->lat, loops, 99), pct(ctl->lat, loops, 99.9),
+		       pct(ctl->lat, loops, 100));
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	munmap(ctl, size);
+	return 0;
+}
@@ -54,6 +54,12 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "share",
+	  "CPU share of tasks with given policy and weights",
+	  bench_sched_share     },
+	{ "wakeup",
+	  "Wakeup latency percentiles under background load",
+	  bench_sched_wakeup    },
 	suite_all,
 	{ NULL,
 	  NULL,
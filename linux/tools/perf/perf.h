@@ -75,6 +75,10 @@
 #define rmb()		((void(*)(void))0xffff0fa0)()
 #define cpu_relax()	asm volatile("":::"memory")
 #define CPUINFO_PROC	"Processor"
+#ifndef __NR_sched_setweight
+# define __NR_sched_setweight 384
+# define __NR_sched_getweight 385
+#endif
 #endif
 
 #ifdef __aarch64__
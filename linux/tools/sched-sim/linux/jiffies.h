@@ -0,0 +1 @@
+/* Provided by the mock sched.h */
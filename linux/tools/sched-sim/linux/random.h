@@ -0,0 +1,3 @@
+#include <stdlib.h>
+
+#define prandom_u32()	((unsigned int)random())
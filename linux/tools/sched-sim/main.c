@@ -0,0 +1,221 @@
+/*
+ * sched-sim: run kernel/sched/wrr.c against simulated runqueues
+ *
+ * usage: sched-sim [-c cpus] [-t seconds] [-g tasks] [-s seed]
+ *                  [-S threads] [-K cluster] [-N nodes] [-T cpus:capacity]
+ *                  [-M costs] [-m] [-C] [-W] [-Z] [-v] [-V] [trace]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] [trace]\n"
+		"  -c cpus     number of simulated cpus (default 4)\n"
+		"  -t seconds  simulated time (default 60)\n"
+		"  -g tasks    add a synthetic task mix\n"
+		"  -s seed     seed for -g (default 1)\n"
+		"  -S threads  hardware threads per core (default 1)\n"
+		"  -K cpus     cpus per cluster (default 1)\n"
+		"  -N nodes    numa nodes (default 1)\n"
+		"  -T cpus:cap run cpus at cap/1024 of full speed, repeatable\n"
+		"  -M us,...   cache refill cost of a move per level: smt,cluster,\n"
+		"              node,remote microseconds\n"
+		"  -m          model -M but keep it from the balancer\n"
+		"  -C          per-cluster runqueues (sched_wrr_cluster)\n"
+		"  -W          distributed work stealing (sched_wrr_steal)\n"
+		"  -Z          idle cpus stop their tick (NO_HZ_IDLE)\n"
+		"  -v          per task report\n"
+		"  -V          check wrr_rq invariants after every tick\n",
+		prog);
+	exit(1);
+}
+
+static int cmp_ulong(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double ticks_ms(double ticks)
+{
+	return ticks * 1000.0 / HZ;
+}
+
+static void report(double wall, int verbose)
+{
+	struct sim_stats *s = &sim_stats;
+	double err = 0, ideal = 0;
+	unsigned long waited = 0;
+	struct sim_task *st;
+	int i;
+
+	if (verbose)
+		printf("%-16s %6s %10s %10s %8s %10s %6s\n", "task", "weight",
+		       "ran_ms", "ideal_ms", "error%", "wait_ms", "migr");
+
+	for (i = 0; i < sim_nr_tasks; i++) {
+		st = &sim_tasks[i];
+		err += st->ran > st->ideal ? st->ran - st->ideal :
+			st->ideal - st->ran;
+		ideal += st->ideal;
+		waited += st->waited;
+		if (verbose)
+			printf("%-16s %6u %10.0f %10.0f %8.2f %10.0f %6lu\n",
+			       st->name, st->task.wrr.weight,
+			       ticks_ms(st->ran), ticks_ms(st->ideal),
+			       st->ideal ? 100.0 * (st->ran - st->ideal) /
+			       st->ideal : 0.0,
+			       ticks_ms(st->waited), st->migrations);
+	}
+	if (verbose)
+		printf("\n");
+
+	qsort(s->latency, s->nr_latency, sizeof(*s->latency), cmp_ulong);
+
+	printf("simulated      %d cpus x %.1f s, %d tasks, HZ=%d\n",
+	       sim_nr_cpus, (double)s->ticks / HZ, sim_nr_tasks, HZ);
+	printf("speed          %.0f cpu-seconds per second (%.3f s wall)\n",
+	       sim_nr_cpus * (double)s->ticks / HZ / wall, wall);
+	printf("utilisation    %.1f%%\n",
+	       100.0 * s->busy / (s->ticks * (double)sim_nr_cpus));
+	printf("smt shared     %.1f%% of busy time\n",
+	       s->busy ? 100.0 * s->smt_shared / s->busy : 0.0);
+	printf("remote node    %.1f%% of busy time\n",
+	       s->busy ? 100.0 * s->remote / s->busy : 0.0);
+	printf("share error    %.2f%% of ideal service\n",
+	       ideal ? 100.0 * err / ideal : 0.0);
+	printf("wait time      %.0f ms total, %.1f ms per task\n",
+	       ticks_ms(waited), ticks_ms((double)waited / sim_nr_tasks));
+	if (s->nr_latency)
+		printf("run latency    p50 %.0f ms, p99 %.0f ms, max %.0f ms "
+		       "(%lu wakeups)\n",
+		       ticks_ms(s->latency[s->nr_latency / 2]),
+		       ticks_ms(s->latency[s->nr_latency * 99 / 100]),
+		       ticks_ms(s->latency[s->nr_latency - 1]),
+		       s->nr_latency);
+	printf("migrations     %lu on wakeup, %lu by the balancer, "
+	       "%lu stolen when idle\n",
+	       s->wake_migrations, s->balance_migrations, s->idle_steals);
+	if (s->refill)
+		printf("cache refill   %.0f ms of work lost after moves\n",
+		       ticks_ms(s->refill));
+	if (sim_nohz)
+		printf("nohz idle      %lu cpu ticks stopped, %lu kicks, "
+		       "%lu tasks pulled\n",
+		       s->tickless, s->nohz_kicks, s->nohz_pulls);
+	printf("balancer       %lu calls, %.0f ns per call\n",
+	       s->balance_calls,
+	       s->balance_calls ? (double)s->balance_ns / s->balance_calls :
+	       0.0);
+	if (sim_verify)
+		printf("invariants     %lu violations\n", s->invariant_errors);
+}
+
+int main(int argc, char **argv)
+{
+	int nr_cpus = 4, synthetic = 0, verbose = 0;
+	int threads = 1, cluster = 1, nodes = 1;
+	int sim_cluster = 0, sim_steal = 0;
+	unsigned int seed = 1;
+	double seconds = 60;
+	struct timespec t0, t1;
+	const char *caps[SIM_MAX_CPUS], *costs = NULL;
+	int tell_cost = 1;
+	int nr_caps = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "c:t:g:s:S:K:N:T:M:mCWZvV")) != -1) {
+		switch (c) {
+		case 'c':
+			nr_cpus = atoi(optarg);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 'g':
+			synthetic = atoi(optarg);
+			break;
+		case 's':
+			seed = atoi(optarg);
+			break;
+		case 'S':
+			threads = atoi(optarg);
+			break;
+		case 'K':
+			cluster = atoi(optarg);
+			break;
+		case 'N':
+			nodes = atoi(optarg);
+			break;
+		case 'T':
+			if (nr_caps == SIM_MAX_CPUS)
+				usage(argv[0]);
+			caps[nr_caps++] = optarg;
+			break;
+		case 'M':
+			costs = optarg;
+			break;
+		case 'm':
+			tell_cost = 0;
+			break;
+		case 'C':
+			sim_cluster = 1;
+			break;
+		case 'W':
+			sim_steal = 1;
+			break;
+		case 'Z':
+			sim_nohz = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'V':
+			sim_verify = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (nr_cpus < 1 || nr_cpus > SIM_MAX_CPUS || seconds <= 0 ||
+	    threads < 1 || cluster < 1 || nodes < 1 || nodes > nr_cpus ||
+	    (optind == argc && !synthetic) || optind < argc - 1)
+		usage(argv[0]);
+
+	sim_init(nr_cpus);
+	sim_set_topology(threads, cluster, nodes);
+	sysctl_sched_wrr_cluster = sim_cluster;
+	sysctl_sched_wrr_steal = sim_steal;
+	srandom(seed);
+	for (i = 0; i < nr_caps; i++)
+		if (sim_set_capacity(caps[i])) {
+			fprintf(stderr, "bad capacity '%s'\n", caps[i]);
+			return 1;
+		}
+	if (costs && sim_set_cost(costs, tell_cost)) {
+		fprintf(stderr, "bad costs '%s'\n", costs);
+		return 1;
+	}
+	if (optind < argc && sim_load_trace(argv[optind]))
+		return 1;
+	if (synthetic)
+		sim_synthetic(synthetic, seed, seconds * HZ);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	sim_run(seconds * HZ);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	report(t1.tv_sec - t0.tv_sec + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+	       verbose);
+	return sim_stats.invariant_errors ? 2 : 0;
+}
@@ -0,0 +1,250 @@
+#ifndef SCHED_SIM_SCHED_H
+#define SCHED_SIM_SCHED_H
+/*
+ * Mock of kernel/sched/sched.h: just enough of struct rq, struct
+ * task_struct and the core scheduler API for kernel/sched/wrr.c to build
+ * and run unmodified in user space. Locking is a no-op since the simulator
+ * is single threaded; the clock is the simulated jiffies counter.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/list.h>
+
+#ifndef HZ
+#define HZ 100
+#endif
+
+#define SIM_MAX_CPUS	64
+
+#define TICK_NSEC	(1000000000UL / HZ)
+
+typedef uint64_t u64;
+
+#define SCHED_POWER_SHIFT	10
+#define SCHED_POWER_SCALE	(1L << SCHED_POWER_SHIFT)
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define WARN_ON_ONCE(cond)	(cond)
+#define ACCESS_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define clamp_t(type, val, lo, hi) \
+	((type)(val) < (type)(lo) ? (type)(lo) : \
+	 (type)(val) > (type)(hi) ? (type)(hi) : (type)(val))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+extern unsigned long jiffies;
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+
+/* locking */
+typedef struct { int dummy; } raw_spinlock_t;
+typedef struct { int dummy; } spinlock_t;
+
+#define DEFINE_SPINLOCK(x)		spinlock_t x
+#define raw_spin_lock_init(l)		do { (void)(l); } while (0)
+#define raw_spin_lock(l)		do { (void)(l); } while (0)
+#define raw_spin_unlock(l)		do { (void)(l); } while (0)
+#define raw_spin_lock_irqsave(l, f)	do { (void)(l); (f) = 0; } while (0)
+#define raw_spin_unlock_irqrestore(l, f) do { (void)(l); (void)(f); } while (0)
+#define raw_spin_trylock(l)		((void)(l), 1)
+#define spin_lock(l)			do { (void)(l); } while (0)
+#define spin_unlock(l)			do { (void)(l); } while (0)
+#define rcu_read_lock()			do { } while (0)
+#define rcu_read_unlock()		do { } while (0)
+
+/* cpumasks, at most SIM_MAX_CPUS */
+struct cpumask {
+	unsigned long long bits;
+};
+
+extern struct cpumask sim_online_mask;
+extern int sim_nr_cpus;
+
+static inline int cpumask_test_cpu(int cpu, const struct cpumask *mask)
+{
+	return (mask->bits >> cpu) & 1;
+}
+
+#define for_each_cpu(cpu, mask)					\
+	for ((cpu) = 0; (cpu) < sim_nr_cpus; (cpu)++)		\
+		if (cpumask_test_cpu(cpu, mask))
+#define for_each_online_cpu(cpu)	for_each_cpu(cpu, &sim_online_mask)
+#define cpu_online(cpu)		cpumask_test_cpu(cpu, &sim_online_mask)
+#define cpu_online_mask		(&sim_online_mask)
+#define nr_cpu_ids		sim_nr_cpus
+
+/* next cpu in mask after n, or nr_cpu_ids */
+static inline int cpumask_next(int n, const struct cpumask *mask)
+{
+	while (++n < sim_nr_cpus)
+		if (cpumask_test_cpu(n, mask))
+			break;
+	return n;
+}
+
+#define cpumask_first(mask)	cpumask_next(-1, mask)
+
+/* topology, set up by sim_set_topology() */
+extern struct cpumask sim_thread_mask[];
+extern struct cpumask sim_node_mask[];
+extern struct cpumask sim_core_mask[];
+extern int sim_cpu_node[];
+
+#define topology_thread_cpumask(cpu)	(&sim_thread_mask[(cpu)])
+#define cpu_to_node(cpu)		(sim_cpu_node[(cpu)])
+#define cpumask_of_node(node)		(&sim_node_mask[(node)])
+#define topology_core_cpumask(cpu)	(&sim_core_mask[(cpu)])
+#define NUMA_NO_NODE			(-1)
+
+/* tasks */
+#define SCHED_NORMAL	0
+#define SCHED_WRR	6
+
+struct sched_wrr_entity {
+	struct list_head run_list;
+	unsigned int weight;
+	unsigned int time_slice;
+#ifdef CONFIG_NUMA
+	int home_node;
+	int home_ticks;
+#endif
+};
+
+struct task_struct {
+	int pid;
+	int policy;
+	int on_rq;
+	int cpu;			/* task_thread_info(p)->cpu */
+	int need_resched;		/* TIF_NEED_RESCHED */
+	int nr_cpus_allowed;
+	struct cpumask cpus_allowed;
+	struct task_struct *real_parent;
+	struct sched_wrr_entity wrr;
+};
+
+#define tsk_cpus_allowed(p)	(&(p)->cpus_allowed)
+
+static inline unsigned int task_cpu(const struct task_struct *p)
+{
+	return p->cpu;
+}
+
+static inline void set_tsk_need_resched(struct task_struct *p)
+{
+	p->need_resched = 1;
+}
+
+/* enqueue flags used by the class itself */
+#define ENQUEUE_HEAD	2
+
+/* wake flags; the simulator only issues plain wakeups from cpu 0 */
+#define WF_SYNC		0x01
+#define smp_processor_id()	0
+
+/* runqueues */
+struct wrr_rq {
+	unsigned long total_weight;
+	struct list_head run_queue;
+	struct task_struct *curr;
+	raw_spinlock_t lock;
+	unsigned long capacity;
+	unsigned long stealable;
+	unsigned long nr_steals;
+	unsigned long next_steal;
+};
+
+struct rq {
+	raw_spinlock_t lock;
+	int cpu;
+	struct task_struct *curr;	/* NULL while idle */
+	struct wrr_rq wrr;
+};
+
+extern struct rq sim_rqs[SIM_MAX_CPUS];
+#define cpu_rq(cpu)		(&sim_rqs[(cpu)])
+
+struct sched_class {
+	const struct sched_class *next;
+
+	void (*enqueue_task)(struct rq *rq, struct task_struct *p, int flags);
+	void (*dequeue_task)(struct rq *rq, struct task_struct *p, int flags);
+	void (*yield_task)(struct rq *rq);
+	bool (*yield_to_task)(struct rq *rq, struct task_struct *p, bool preempt);
+
+	void (*check_preempt_curr)(struct rq *rq, struct task_struct *p, int flags);
+
+	struct task_struct *(*pick_next_task)(struct rq *rq);
+	void (*put_prev_task)(struct rq *rq, struct task_struct *p);
+
+#ifdef CONFIG_SMP
+	int (*select_task_rq)(struct task_struct *p, int sd_flag, int flags);
+
+	void (*pre_schedule)(struct rq *this_rq, struct task_struct *task);
+	void (*post_schedule)(struct rq *this_rq);
+	void (*task_waking)(struct task_struct *task);
+	void (*task_woken)(struct rq *this_rq, struct task_struct *task);
+
+	void (*set_cpus_allowed)(struct task_struct *p,
+				 const struct cpumask *newmask);
+
+	void (*rq_online)(struct rq *rq);
+	void (*rq_offline)(struct rq *rq);
+#endif
+
+	void (*set_curr_task)(struct rq *rq);
+	void (*task_tick)(struct rq *rq, struct task_struct *p, int queued);
+	void (*task_fork)(struct task_struct *p);
+
+	void (*switched_from)(struct rq *this_rq, struct task_struct *task);
+	void (*switched_to)(struct rq *this_rq, struct task_struct *task);
+	void (*prio_changed)(struct rq *this_rq, struct task_struct *task,
+			     int oldprio);
+
+	unsigned int (*get_rr_interval)(struct rq *rq,
+					struct task_struct *task);
+};
+
+extern const struct sched_class wrr_sched_class;
+extern const struct sched_class fair_sched_class;
+
+/* provided by the simulator core in place of kernel/sched/core.c */
+extern void activate_task(struct rq *rq, struct task_struct *p, int flags);
+extern void deactivate_task(struct rq *rq, struct task_struct *p, int flags);
+extern void set_task_cpu(struct task_struct *p, unsigned int cpu);
+extern void double_rq_lock(struct rq *rq1, struct rq *rq2);
+extern void double_rq_unlock(struct rq *rq1, struct rq *rq2);
+static inline int double_lock_balance(struct rq *this_rq, struct rq *busiest)
+{
+	return 0;
+}
+static inline void double_unlock_balance(struct rq *this_rq,
+					 struct rq *busiest)
+{
+}
+extern void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags);
+
+/* provided by kernel/sched/wrr.c */
+enum {
+	WRR_LEVEL_SMT,
+	WRR_LEVEL_CLUSTER,
+	WRR_LEVEL_NODE,
+	WRR_LEVEL_REMOTE,
+	WRR_NR_LEVELS,
+};
+
+extern u64 wrr_migration_cost[WRR_NR_LEVELS];
+extern int wrr_level(int src, int dst);
+extern void init_wrr_rq(struct wrr_rq *wrr_rq, struct rq *rq);
+extern void set_weight_wrr(struct rq *rq, struct task_struct *p,
+			   unsigned int weight);
+extern void load_balance_wrr(struct rq *rq);
+extern void idle_steal_wrr(struct rq *rq);
+extern void nohz_pull_wrr(struct rq *rq);
+extern unsigned int sysctl_sched_wrr_steal;
+extern unsigned int sysctl_sched_wrr_cluster;
+extern void sched_wrr_set_capacity(int cpu, unsigned long capacity);
+
+#endif
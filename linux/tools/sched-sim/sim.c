@@ -0,0 +1,521 @@
+/*
+ * Simulator core: stands in for the parts of kernel/sched/core.c that
+ * drive a scheduling class (schedule, scheduler_tick, try_to_wake_up,
+ * wake_up_new_task) and accounts what the WRR class makes of it.
+ *
+ * Only WRR tasks are simulated, so rq->nr_running is always 0. The idle
+ * steal in schedule() and the nohz kick therefore reduce to their WRR
+ * conditions: no WRR weight queued, and stealable WRR weight advertised.
+ * The kernel also kicks for CFS work and a shared package with more than
+ * one busy cpu. The sim does neither.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+
+unsigned long jiffies;
+int sim_nr_cpus;
+struct cpumask sim_online_mask;
+struct rq sim_rqs[SIM_MAX_CPUS];
+struct cpumask sim_thread_mask[SIM_MAX_CPUS];
+struct cpumask sim_node_mask[SIM_MAX_CPUS];
+struct cpumask sim_core_mask[SIM_MAX_CPUS];
+int sim_cpu_node[SIM_MAX_CPUS];
+const struct sched_class fair_sched_class;
+
+struct sim_stats sim_stats;
+int sim_verify;
+int sim_nohz;
+double sim_cost[WRR_NR_LEVELS];		/* ticks lost per move (-M) */
+static int sim_idle[SIM_MAX_CPUS];	/* tick stopped in idle (-Z) */
+
+static struct task_struct sim_parent;	/* forks every task */
+static int in_balance;			/* 1: balancer, 2: idle steal, 3: nohz */
+
+static struct sim_task *sim_task_of(struct task_struct *p)
+{
+	return container_of(p, struct sim_task, task);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void activate_task(struct rq *rq, struct task_struct *p, int flags)
+{
+	struct sim_task *st = sim_task_of(p);
+
+	wrr_sched_class.enqueue_task(rq, p, flags);
+	if (!st->waiting) {
+		st->waiting = 1;
+		st->queued_at = jiffies;
+	}
+}
+
+void deactivate_task(struct rq *rq, struct task_struct *p, int flags)
+{
+	wrr_sched_class.dequeue_task(rq, p, flags);
+}
+
+void set_task_cpu(struct task_struct *p, unsigned int cpu)
+{
+	struct sim_task *st = sim_task_of(p);
+
+	if (p->cpu == (int)cpu)
+		return;
+
+	st->migrations++;
+	/* a task that has not run yet has no caches to lose */
+	if (st->mem_node >= 0)
+		st->refill += sim_cost[wrr_level(p->cpu, cpu)];
+	if (in_balance == 3)
+		sim_stats.nohz_pulls++;
+	else if (in_balance == 2)
+		sim_stats.idle_steals++;
+	else if (in_balance)
+		sim_stats.balance_migrations++;
+	else
+		sim_stats.wake_migrations++;
+	p->cpu = cpu;
+}
+
+void double_rq_lock(struct rq *rq1, struct rq *rq2)
+{
+}
+
+void double_rq_unlock(struct rq *rq1, struct rq *rq2)
+{
+}
+
+/* an idle rq picks the task up at its next sim_schedule() anyway */
+void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags)
+{
+}
+
+void sim_init(int nr_cpus)
+{
+	int cpu;
+
+	sim_nr_cpus = nr_cpus;
+	sim_online_mask.bits = nr_cpus == 64 ? ~0ULL : (1ULL << nr_cpus) - 1;
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		sim_rqs[cpu].cpu = cpu;
+		init_wrr_rq(&sim_rqs[cpu].wrr, &sim_rqs[cpu]);
+	}
+	sim_set_topology(1, 1, 1);
+	sim_parent.policy = SCHED_WRR;
+}
+
+/*
+ * -S threads -K cluster -N nodes: consecutive cpus are hardware threads of
+ * one core, consecutive cpus form a cluster sharing a cache, and
+ * consecutive cores share a node, as on most enumerations.
+ */
+static unsigned long long sim_group(int cpu, int size)
+{
+	int first = cpu - cpu % size;
+	unsigned long long bits = 0;
+
+	while (first < sim_nr_cpus && first < cpu - cpu % size + size)
+		bits |= 1ULL << first++;
+	return bits;
+}
+
+void sim_set_topology(int threads, int cluster, int nodes)
+{
+	int cpu;
+
+	memset(sim_node_mask, 0, sizeof(sim_node_mask));
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++) {
+		sim_thread_mask[cpu].bits = sim_group(cpu, threads);
+		sim_core_mask[cpu].bits = sim_group(cpu, cluster);
+		sim_cpu_node[cpu] = cpu * nodes / sim_nr_cpus;
+		sim_node_mask[sim_cpu_node[cpu]].bits |= 1ULL << cpu;
+	}
+}
+
+static void record_latency(unsigned long ticks)
+{
+	struct sim_stats *s = &sim_stats;
+
+	if (s->nr_latency == s->latency_size) {
+		s->latency_size = s->latency_size ? 2 * s->latency_size : 4096;
+		s->latency = realloc(s->latency,
+				     s->latency_size * sizeof(*s->latency));
+		if (!s->latency) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	s->latency[s->nr_latency++] = ticks;
+}
+
+/* schedule(): put the previous task back and take the cursor task */
+static void sim_schedule(struct rq *rq)
+{
+	struct task_struct *prev = rq->curr, *next;
+	struct sim_task *st;
+
+	if (prev) {
+		prev->need_resched = 0;
+		wrr_sched_class.put_prev_task(rq, prev);
+	}
+
+	/* core.c: !rq->nr_running && !rq->wrr.total_weight */
+	if (!rq->wrr.total_weight) {
+		in_balance = 2;
+		idle_steal_wrr(rq);
+		in_balance = 0;
+	}
+
+	next = wrr_sched_class.pick_next_task(rq);
+	rq->curr = next;
+	if (!next)
+		return;
+
+	st = sim_task_of(next);
+	if (st->mem_node < 0)
+		st->mem_node = cpu_to_node(rq->cpu);
+	if (st->waiting) {
+		st->waiting = 0;
+		record_latency(jiffies - st->queued_at);
+	}
+}
+
+/* wake_up_new_task() and try_to_wakeup() */
+static void sim_wake(struct sim_task *st, int sd_flag)
+{
+	struct task_struct *p = &st->task;
+	int cpu;
+
+	cpu = wrr_sched_class.select_task_rq(p, sd_flag, 0);
+	set_task_cpu(p, cpu);
+	st->state = SIM_RUNNABLE;
+	st->burst_left = st->run;
+	activate_task(cpu_rq(cpu), p, sd_flag == SD_BALANCE_WAKE ?
+		      ENQUEUE_WAKEUP : 0);
+}
+
+static void sim_fork(struct sim_task *st)
+{
+	struct task_struct *p = &st->task;
+	int cpu;
+
+	p->policy = SCHED_WRR;
+	p->cpus_allowed = st->cpus;
+	p->nr_cpus_allowed = __builtin_popcountll(st->cpus.bits);
+	INIT_LIST_HEAD(&p->wrr.run_list);
+
+	/* forked on the first allowed cpu, like a launcher pinned there */
+	for (cpu = 0; !cpumask_test_cpu(cpu, &st->cpus); cpu++)
+		;
+	p->cpu = cpu;
+
+	/*
+	 * Children inherit the parent's weight and home node in
+	 * task_fork_wrr; the task's own memory is touched where it first
+	 * runs, as after an exec.
+	 */
+	sim_parent.wrr.weight = st->weight;
+	sim_parent.wrr.home_node = cpu_to_node(cpu);
+	p->real_parent = &sim_parent;
+	wrr_sched_class.task_fork(p);
+	st->mem_node = -1;
+	sim_wake(st, SD_BALANCE_FORK);
+}
+
+static void sim_exit(struct sim_task *st)
+{
+	struct task_struct *p = &st->task;
+	struct rq *rq = cpu_rq(task_cpu(p));
+
+	if (st->state == SIM_RUNNABLE) {
+		if (rq->curr == p)
+			rq->curr = NULL;
+		deactivate_task(rq, p, DEQUEUE_SLEEP);
+	}
+	st->state = SIM_DEAD;
+}
+
+static void sim_events(void)
+{
+	struct sim_task *st;
+	int i;
+
+	for (i = 0; i < sim_nr_tasks; i++) {
+		st = &sim_tasks[i];
+		if (st->state == SIM_DEAD)
+			continue;
+		if (st->exit && jiffies >= st->exit && st->state != SIM_NEW)
+			sim_exit(st);
+		else if (st->state == SIM_NEW && jiffies >= st->arrive)
+			sim_fork(st);
+		else if (st->state == SIM_SLEEPING && jiffies >= st->wake_at)
+			sim_wake(st, SD_BALANCE_WAKE);
+	}
+}
+
+static int cmp_weight_desc(const void *a, const void *b)
+{
+	const struct sim_task *x = *(struct sim_task * const *)a;
+	const struct sim_task *y = *(struct sim_task * const *)b;
+
+	return (int)y->task.wrr.weight - (int)x->task.wrr.weight;
+}
+
+/* the fraction of full speed a cpu runs at, as set by -T */
+static double sim_speed(int cpu)
+{
+	return (double)cpu_rq(cpu)->wrr.capacity / SCHED_POWER_SCALE;
+}
+
+/*
+ * Credit every runnable task with what an ideal weighted fair scheduler
+ * would give it for this tick: the summed speed of the online cpus is
+ * split in proportion to weight, but no task can use more than the
+ * fastest cpu.
+ */
+static void sim_account_ideal(void)
+{
+	static struct sim_task *runnable[SIM_MAX_TASKS];
+	double capacity = 0, fastest = 0, weight = 0, share;
+	int i, n = 0, cpu;
+
+	for_each_online_cpu(cpu) {
+		capacity += sim_speed(cpu);
+		if (sim_speed(cpu) > fastest)
+			fastest = sim_speed(cpu);
+	}
+
+	for (i = 0; i < sim_nr_tasks; i++) {
+		if (sim_tasks[i].state != SIM_RUNNABLE)
+			continue;
+		runnable[n++] = &sim_tasks[i];
+		weight += sim_tasks[i].task.wrr.weight;
+		if (cpu_rq(task_cpu(&sim_tasks[i].task))->curr !=
+		    &sim_tasks[i].task)
+			sim_tasks[i].waited++;
+	}
+
+	qsort(runnable, n, sizeof(*runnable), cmp_weight_desc);
+	for (i = 0; i < n; i++) {
+		share = capacity * runnable[i]->task.wrr.weight / weight;
+		if (share > fastest)
+			share = fastest;
+		runnable[i]->ideal += share;
+		capacity -= share;
+		weight -= runnable[i]->task.wrr.weight;
+	}
+}
+
+/* speed of the task running on rq this tick, including its slowdowns */
+static double sim_task_speed(struct rq *rq, struct sim_task *st)
+{
+	double speed = sim_speed(rq->cpu);
+	int sibling;
+
+	for_each_cpu(sibling, topology_thread_cpumask(rq->cpu)) {
+		if (sibling != rq->cpu && cpu_rq(sibling)->curr) {
+			speed *= SIM_SMT_SPEED;
+			sim_stats.smt_shared++;
+			break;
+		}
+	}
+	if (cpu_to_node(rq->cpu) != st->mem_node) {
+		speed *= SIM_REMOTE_SPEED;
+		sim_stats.remote++;
+	}
+	return speed;
+}
+
+/* one tick of the running task, then scheduler_tick() */
+static void sim_tick(struct rq *rq)
+{
+	struct task_struct *p = rq->curr;
+	struct sim_task *st;
+	double speed, lost;
+
+	if (!p)
+		return;
+
+	st = sim_task_of(p);
+	speed = sim_task_speed(rq, st);
+	if (st->refill > 0) {
+		lost = st->refill < speed ? st->refill : speed;
+		st->refill -= lost;
+		speed -= lost;
+		sim_stats.refill += lost;
+	}
+	st->ran += speed;
+	st->burst_left -= speed;
+	sim_stats.busy++;
+
+	if (st->run && st->burst_left <= 0) {
+		/* the task blocks: deactivate_task from schedule() */
+		rq->curr = NULL;
+		deactivate_task(rq, p, DEQUEUE_SLEEP);
+		st->state = SIM_SLEEPING;
+		st->wake_at = jiffies + st->sleep;
+		return;
+	}
+
+	wrr_sched_class.task_tick(rq, p, 0);
+}
+
+static void sim_check(struct rq *rq)
+{
+	struct sched_wrr_entity *se;
+	unsigned long weight = 0;
+	int found = rq->wrr.curr == NULL;
+
+	list_for_each_entry(se, &rq->wrr.run_queue, run_list) {
+		weight += se->weight;
+		if (container_of(se, struct task_struct, wrr) == rq->wrr.curr)
+			found = 1;
+	}
+
+	if (weight != rq->wrr.total_weight || !found ||
+	    (rq->wrr.curr == NULL) != list_empty(&rq->wrr.run_queue)) {
+		if (!sim_stats.invariant_errors)
+			fprintf(stderr, "tick %lu cpu %d: total_weight %lu, "
+				"queued weight %lu, cursor %s\n", jiffies,
+				rq->cpu, rq->wrr.total_weight, weight,
+				found ? "valid" : "invalid");
+		sim_stats.invariant_errors++;
+	}
+}
+
+/*
+ * -T cpus:capacity, e.g. 4-7:512 runs cpus 4-7 at half speed, the way
+ * cpufreq_thermal_limit() reports a thermally capped cluster.
+ */
+int sim_set_capacity(const char *str)
+{
+	struct cpumask mask;
+	char cpus[64], *colon;
+	long capacity;
+	int cpu;
+
+	colon = strchr(str, ':');
+	if (!colon || colon - str >= (int)sizeof(cpus))
+		return -1;
+	memcpy(cpus, str, colon - str);
+	cpus[colon - str] = '\0';
+	capacity = atol(colon + 1);
+	if (sim_parse_cpus(cpus, &mask) || capacity < 1 ||
+	    capacity > SCHED_POWER_SCALE)
+		return -1;
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++)
+		if (cpumask_test_cpu(cpu, &mask))
+			sched_wrr_set_capacity(cpu, capacity);
+	return 0;
+}
+
+/*
+ * -M smt,cluster,node,remote: microseconds a task loses refilling its
+ * caches after a move at each level. With tell, wrr_migration_cost[] is
+ * set to match, as if wrr_cost.c had measured this machine; without, the
+ * balancer runs as before calibration.
+ */
+int sim_set_cost(const char *str, int tell)
+{
+	char *end;
+	double us;
+	int level;
+
+	for (level = 0; level < WRR_NR_LEVELS; level++) {
+		us = strtod(str, &end);
+		if (end == str || us < 0)
+			return -1;
+		sim_cost[level] = us * 1000 / TICK_NSEC;
+		if (tell)
+			wrr_migration_cost[level] = us * 1000;
+		if (*end != ',')
+			break;
+		str = end + 1;
+	}
+	return *end ? -1 : 0;
+}
+
+/*
+ * nohz_kick_needed() and nohz_idle_balance(): a ticking cpu advertising
+ * stealable WRR weight kicks the first tickless cpu, which pulls for every
+ * tickless cpu. At most one kick per tick, like nohz.next_balance.
+ */
+static void sim_nohz_kick(void)
+{
+	int cpu, kick = 0, idle = 0;
+
+	for_each_online_cpu(cpu) {
+		if (sim_idle[cpu])
+			idle = 1;
+		else if (cpu_rq(cpu)->wrr.stealable)
+			kick = 1;
+	}
+	if (!kick || !idle)
+		return;
+
+	sim_stats.nohz_kicks++;
+	in_balance = 3;
+	for_each_online_cpu(cpu)
+		if (sim_idle[cpu])
+			nohz_pull_wrr(cpu_rq(cpu));
+	in_balance = 0;
+}
+
+void sim_run(unsigned long ticks)
+{
+	unsigned long long t0;
+	struct rq *rq;
+	int cpu;
+
+	for (jiffies = 1; jiffies <= ticks; jiffies++) {
+		sim_events();
+
+		for_each_online_cpu(cpu) {
+			rq = cpu_rq(cpu);
+			/* a tickless cpu sleeps until work is queued on it */
+			if (sim_idle[cpu] && !rq->wrr.total_weight)
+				continue;
+			sim_idle[cpu] = 0;
+			if (!rq->curr || rq->curr->need_resched)
+				sim_schedule(rq);
+			if (sim_nohz && !rq->curr)
+				sim_idle[cpu] = 1;
+		}
+
+		sim_account_ideal();
+
+		for_each_online_cpu(cpu)
+			sim_tick(cpu_rq(cpu));
+
+		in_balance = 1;
+		for_each_online_cpu(cpu) {
+			if (sim_idle[cpu]) {
+				sim_stats.tickless++;
+				continue;
+			}
+			t0 = now_ns();
+			load_balance_wrr(cpu_rq(cpu));
+			sim_stats.balance_ns += now_ns() - t0;
+			sim_stats.balance_calls++;
+		}
+		in_balance = 0;
+
+		if (sim_nohz)
+			sim_nohz_kick();
+
+		if (sim_verify)
+			for_each_online_cpu(cpu)
+				sim_check(cpu_rq(cpu));
+	}
+	sim_stats.ticks = ticks;
+}
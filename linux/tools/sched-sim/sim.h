@@ -0,0 +1,96 @@
+#ifndef SCHED_SIM_H
+#define SCHED_SIM_H
+
+#include "sched.h"
+
+#define SIM_MAX_TASKS		4096
+#define SIM_NAME_LEN		32
+
+/* sd_flag / enqueue / dequeue flags as passed by kernel/sched/core.c */
+#define SD_BALANCE_FORK		0x08
+#define SD_BALANCE_WAKE		0x10
+#define ENQUEUE_WAKEUP		1
+#define DEQUEUE_SLEEP		1
+
+enum sim_state {
+	SIM_NEW,
+	SIM_RUNNABLE,
+	SIM_SLEEPING,
+	SIM_DEAD,
+};
+
+struct sim_task {
+	struct task_struct task;
+	char name[SIM_NAME_LEN];
+
+	/* behaviour, all times in ticks */
+	unsigned int weight;
+	unsigned long arrive;
+	unsigned long exit;		/* 0: runs until the end */
+	unsigned int run;		/* burst length, 0: never sleeps */
+	unsigned int sleep;
+	struct cpumask cpus;
+	int mem_node;			/* first touch, -1 until it runs */
+
+	/* state */
+	enum sim_state state;
+	double burst_left;		/* work left in the burst, in full speed ticks */
+	double refill;			/* work lost to cold caches after a move */
+	unsigned long wake_at;
+	unsigned long queued_at;
+	int waiting;			/* enqueued and not run since */
+
+	/* statistics */
+	double ran;			/* work done, in full speed ticks */
+	double ideal;			/* ticks owed by exact proportional share */
+	unsigned long waited;
+	unsigned long migrations;
+};
+
+struct sim_stats {
+	unsigned long ticks;
+	unsigned long busy;		/* cpu ticks spent running a task */
+	unsigned long smt_shared;	/* ... of which with a sibling busy */
+	unsigned long remote;		/* ... of which away from mem_node */
+	unsigned long wake_migrations;
+	unsigned long balance_migrations;
+	unsigned long idle_steals;
+	unsigned long nohz_pulls;
+	unsigned long nohz_kicks;
+	unsigned long tickless;		/* cpu ticks skipped in nohz idle */
+	double refill;			/* full speed ticks lost to cold caches */
+	unsigned long balance_calls;
+	unsigned long long balance_ns;
+	unsigned long *latency;		/* enqueue to first run, ticks */
+	unsigned long nr_latency;
+	unsigned long latency_size;
+	unsigned long invariant_errors;
+};
+
+extern struct sim_task *sim_tasks;
+extern int sim_nr_tasks;
+extern struct sim_stats sim_stats;
+extern int sim_verify;
+extern int sim_nohz;
+extern double sim_cost[WRR_NR_LEVELS];
+
+/* sim.c */
+void sim_init(int nr_cpus);
+void sim_set_topology(int threads, int cluster, int nodes);
+void sim_run(unsigned long ticks);
+int sim_set_capacity(const char *str);
+int sim_set_cost(const char *str, int tell);
+
+/* trace.c */
+struct sim_task *sim_new_task(void);
+int sim_load_trace(const char *path);
+void sim_synthetic(int nr, unsigned int seed, unsigned long ticks);
+int sim_parse_cpus(const char *str, struct cpumask *mask);
+
+/* slowdown of a task sharing its core, or running away from its memory */
+#define SIM_SMT_SPEED		0.625
+#define SIM_REMOTE_SPEED	0.8
+
+#define MS_TO_TICKS(ms)	(((unsigned long)(ms) * HZ + 999) / 1000)
+
+#endif
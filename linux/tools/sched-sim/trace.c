@@ -0,0 +1,192 @@
+/*
+ * Task traces for the simulator.
+ *
+ * One task per line, as key=value pairs; '#' starts a comment:
+ *
+ *   name=video weight=15 at=0 run=8 sleep=8 cpus=0-3
+ *   name=spin weight=10 count=4 exit=5000
+ *
+ *   name    label in the report
+ *   weight  SCHED_WRR weight, 1..20 (default 10)
+ *   at      arrival (fork) time in ms (default 0)
+ *   run     ms of cpu per burst, 0 or absent for a pure spinner
+ *   sleep   ms of sleep after each burst
+ *   exit    exit time in ms, absent to run until the end
+ *   cpus    allowed cpus, e.g. 0-3,6 (default all)
+ *   count   number of identical tasks to create (default 1)
+ *
+ * Recorded workloads can be turned into this format from sched_switch and
+ * sched_wakeup events by averaging each task's run and sleep periods.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+struct sim_task *sim_tasks;
+int sim_nr_tasks;
+
+struct sim_task *sim_new_task(void)
+{
+	struct sim_task *st;
+
+	if (!sim_tasks) {
+		sim_tasks = calloc(SIM_MAX_TASKS, sizeof(*sim_tasks));
+		if (!sim_tasks) {
+			perror("calloc");
+			exit(1);
+		}
+	}
+	if (sim_nr_tasks == SIM_MAX_TASKS)
+		return NULL;
+
+	st = &sim_tasks[sim_nr_tasks];
+	st->task.pid = ++sim_nr_tasks;
+	st->weight = 10;
+	st->cpus = sim_online_mask;
+	snprintf(st->name, SIM_NAME_LEN, "task%d", st->task.pid);
+	return st;
+}
+
+int sim_parse_cpus(const char *str, struct cpumask *mask)
+{
+	char *end;
+	long a, b;
+
+	mask->bits = 0;
+	while (*str) {
+		a = b = strtol(str, &end, 10);
+		if (end == str)
+			return -1;
+		if (*end == '-') {
+			str = end + 1;
+			b = strtol(str, &end, 10);
+			if (end == str)
+				return -1;
+		}
+		if (a < 0 || b < a || b >= sim_nr_cpus)
+			return -1;
+		for (; a <= b; a++)
+			mask->bits |= 1ULL << a;
+		str = end;
+		if (*str == ',')
+			str++;
+		else if (*str)
+			return -1;
+	}
+	return mask->bits ? 0 : -1;
+}
+
+static int parse_line(char *line, int lineno)
+{
+	struct sim_task tmpl, *st;
+	char *tok, *val, *save;
+	long count = 1;
+
+	memset(&tmpl, 0, sizeof(tmpl));
+	tmpl.weight = 10;
+	tmpl.cpus = sim_online_mask;
+
+	for (tok = strtok_r(line, " \t\n", &save); tok;
+	     tok = strtok_r(NULL, " \t\n", &save)) {
+		val = strchr(tok, '=');
+		if (!val)
+			goto bad;
+		*val++ = '\0';
+
+		if (!strcmp(tok, "name"))
+			snprintf(tmpl.name, SIM_NAME_LEN, "%s", val);
+		else if (!strcmp(tok, "weight"))
+			tmpl.weight = atoi(val);
+		else if (!strcmp(tok, "at"))
+			tmpl.arrive = MS_TO_TICKS(atol(val));
+		else if (!strcmp(tok, "run"))
+			tmpl.run = MS_TO_TICKS(atol(val));
+		else if (!strcmp(tok, "sleep"))
+			tmpl.sleep = MS_TO_TICKS(atol(val));
+		else if (!strcmp(tok, "exit"))
+			tmpl.exit = MS_TO_TICKS(atol(val));
+		else if (!strcmp(tok, "count"))
+			count = atol(val);
+		else if (!strcmp(tok, "cpus")) {
+			if (sim_parse_cpus(val, &tmpl.cpus))
+				goto bad;
+		} else
+			goto bad;
+	}
+
+	if (tmpl.weight < 1 || tmpl.weight > 20 || count < 1)
+		goto bad;
+
+	while (count--) {
+		st = sim_new_task();
+		if (!st) {
+			fprintf(stderr, "too many tasks, at most %d\n",
+				SIM_MAX_TASKS);
+			return -1;
+		}
+		tmpl.task.pid = st->task.pid;
+		if (!tmpl.name[0])
+			snprintf(tmpl.name, SIM_NAME_LEN, "%s", st->name);
+		*st = tmpl;
+	}
+	return 0;
+
+bad:
+	fprintf(stderr, "trace line %d: invalid '%s'\n", lineno, tok);
+	return -1;
+}
+
+int sim_load_trace(const char *path)
+{
+	char line[512], *p;
+	int lineno = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		p = strchr(line, '#');
+		if (p)
+			*p = '\0';
+		if (strspn(line, " \t\n") == strlen(line))
+			continue;
+		if (parse_line(line, lineno)) {
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/*
+ * A random mix: a third of the tasks spin, the rest alternate 1..50ms
+ * bursts with 1..100ms sleeps. Weights are uniform over 1..20 and tasks
+ * arrive during the first tenth of the run.
+ */
+void sim_synthetic(int nr, unsigned int seed, unsigned long ticks)
+{
+	struct sim_task *st;
+	int i;
+
+	srand(seed);
+	for (i = 0; i < nr; i++) {
+		st = sim_new_task();
+		if (!st)
+			return;
+		st->weight = 1 + rand() % 20;
+		st->arrive = rand() % (ticks / 10 + 1);
+		if (i % 3) {
+			st->run = MS_TO_TICKS(1 + rand() % 50);
+			st->sleep = MS_TO_TICKS(1 + rand() % 100);
+		}
+	}
+}
@@ -0,0 +1,120 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark scenario: fork storm convergence
+
+	The parent pins itself to one CPU and forks 'nr_tasks' spinners in a
+	burst, so they all start on the same runqueue. The children then widen
+	their affinity to every CPU and report where they run. We measure how
+	long load balancing takes until no CPU holds more than one task above
+	any other.
+*/
+
+#include "wrr_bench.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define FORK_SAMPLE_US	10000
+#define FORK_STABLE	3	/* consecutive balanced samples needed */
+
+struct fork_ctl {
+	volatile int ready;
+	volatile int cpu[WRR_MAX_TASKS];
+	volatile int migrations[WRR_MAX_TASKS];
+};
+
+static void fork_child(struct fork_ctl *ctl, int i)
+{
+	int cpu, last = -1;
+
+	pin_cpu(-1);
+	__sync_fetch_and_add(&ctl->ready, 1);
+
+	for (;;) {
+		spin_for_ns(1000000);
+		cpu = sched_getcpu();
+		if (last != -1 && cpu != last)
+			ctl->migrations[i]++;
+		ctl->cpu[i] = last = cpu;
+	}
+}
+
+static int imbalance(struct fork_ctl *ctl, int n, int nr_cpus)
+{
+	int count[CPU_SETSIZE] = { 0 };
+	int i, min, max;
+
+	for (i = 0; i < n; i++)
+		if (ctl->cpu[i] >= 0 && ctl->cpu[i] < nr_cpus)
+			count[ctl->cpu[i]]++;
+	min = max = count[0];
+	for (i = 1; i < nr_cpus; i++) {
+		if (count[i] < min)
+			min = count[i];
+		if (count[i] > max)
+			max = count[i];
+	}
+	return max - min;
+}
+
+int bench_fork(struct bench_opts *opts)
+{
+	static const char * const cols[] = {
+		"rep", "policy", "tasks", "cpus", "converged", "converge_ms",
+		"final_imbalance", "migrations",
+	};
+	struct fork_ctl *ctl;
+	pid_t pids[WRR_MAX_TASKS];
+	int nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int n = opts->nr_tasks;
+	int rep, i, stable, imb, migrations;
+	uint64_t start, elapsed, limit;
+
+	out_begin(opts, "fork", cols, 8);
+
+	for (rep = 0; rep < opts->reps; rep++) {
+		ctl = shared_alloc(sizeof(*ctl));
+		for (i = 0; i < n; i++)
+			ctl->cpu[i] = -1;
+
+		pin_cpu(opts->cpu < 0 ? 0 : opts->cpu);
+		set_policy(0, opts->policy);
+		if (opts->policy == SCHED_WRR)
+			set_weight(0, opts->weights[0]);
+
+		start = now_ns();
+		for (i = 0; i < n; i++) {
+			pids[i] = fork();
+			if (pids[i] == 0)
+				fork_child(ctl, i);
+		}
+		/* let the parent run anywhere so it does not hold the fork CPU */
+		pin_cpu(-1);
+
+		limit = opts->duration * 1e9;
+		stable = 0;
+		imb = n;
+		do {
+			usleep(FORK_SAMPLE_US);
+			elapsed = now_ns() - start;
+			if (ctl->ready < n)
+				continue;
+			imb = imbalance(ctl, n, nr_cpus);
+			stable = imb <= 1 ? stable + 1 : 0;
+		} while (stable < FORK_STABLE && elapsed < limit);
+
+		migrations = 0;
+		for (i = 0; i < n; i++)
+			migrations += ctl->migrations[i];
+
+		reap_children(pids, n);
+		out_row(opts, "%d,%s,%d,%d,%d,%.1f,%d,%d", rep,
+			policy_name(opts->policy), n, nr_cpus,
+			stable >= FORK_STABLE, elapsed / 1e6, imb, migrations);
+		shared_free(ctl, sizeof(*ctl));
+	}
+
+	out_end(opts);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark suite driver
+
+	usage: wrr_bench <scenario> [options]
+*/
+
+#include "wrr_bench.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static struct bench_scenario scenarios[] = {
+	{ "share",	"N spinners on one CPU, achieved vs expected share",	bench_share },
+	{ "fork",	"fork storm, time until the runqueues are balanced",	bench_fork },
+	{ "pingpong",	"pipe ping-pong wakeup latency under load",		bench_pingpong },
+	{ "mixed",	"CPU spinners against sleepers on one CPU",		bench_mixed },
+	{ "weight",	"trial division runtime per weight (plot.pdf)",	bench_weight },
+};
+
+#define NR_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static void usage(const char *prog)
+{
+	unsigned int i;
+
+	fprintf(stderr,
+		"usage: %s <scenario> [options]\n"
+		"  -p policy   wrr, normal or rr (default wrr)\n"
+		"  -c cpu      cpu to pin to, -1 for none (default 0)\n"
+		"  -d secs     measurement time per repetition (default 5)\n"
+		"  -n tasks    number of tasks (default 16)\n"
+		"  -l load     number of background spinners (default 0)\n"
+		"  -r reps     repetitions (default 3)\n"
+		"  -w list     comma separated weights, 1..%d (default 10)\n"
+		"  -f format   csv or json (default csv)\n"
+		"  -o file     write results to file (default stdout)\n"
+		"scenarios:\n", prog, WRR_MAX_WEIGHT);
+	for (i = 0; i < NR_SCENARIOS; i++)
+		fprintf(stderr, "  %-10s %s\n", scenarios[i].name,
+			scenarios[i].summary);
+	exit(1);
+}
+
+static int parse_policy(const char *s)
+{
+	if (!strcmp(s, "wrr"))
+		return SCHED_WRR;
+	if (!strcmp(s, "normal"))
+		return SCHED_NORMAL;
+	if (!strcmp(s, "rr"))
+		return SCHED_RR;
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_opts opts = {
+		.policy		= SCHED_WRR,
+		.cpu		= 0,
+		.duration	= 5,
+		.nr_tasks	= 16,
+		.nr_load	= 0,
+		.reps		= 3,
+		.weights	= { 10 },
+		.nr_weights	= 1,
+		.format		= OUT_CSV,
+	};
+	struct bench_scenario *sc = NULL;
+	const char *weights = NULL;
+	unsigned int i;
+	int c;
+
+	opts.out = stdout;
+	if (argc < 2)
+		usage(argv[0]);
+	for (i = 0; i < NR_SCENARIOS; i++)
+		if (!strcmp(argv[1], scenarios[i].name))
+			sc = &scenarios[i];
+	if (!sc)
+		usage(argv[0]);
+
+	optind = 2;
+	while ((c = getopt(argc, argv, "p:c:d:n:l:r:w:f:o:")) != -1) {
+		switch (c) {
+		case 'p':
+			opts.policy = parse_policy(optarg);
+			if (opts.policy < 0)
+				usage(argv[0]);
+			break;
+		case 'c':
+			opts.cpu = atoi(optarg);
+			break;
+		case 'd':
+			opts.duration = atof(optarg);
+			break;
+		case 'n':
+			opts.nr_tasks = atoi(optarg);
+			break;
+		case 'l':
+			opts.nr_load = atoi(optarg);
+			break;
+		case 'r':
+			opts.reps = atoi(optarg);
+			break;
+		case 'w':
+			weights = optarg;
+			break;
+		case 'f':
+			if (!strcmp(optarg, "json"))
+				opts.format = OUT_JSON;
+			else if (!strcmp(optarg, "csv"))
+				opts.format = OUT_CSV;
+			else
+				usage(argv[0]);
+			break;
+		case 'o':
+			opts.out = fopen(optarg, "w");
+			if (!opts.out) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (opts.nr_tasks < 1 || opts.nr_tasks > WRR_MAX_TASKS ||
+	    opts.nr_load < 0 || opts.nr_load > WRR_MAX_TASKS ||
+	    opts.reps < 1 || opts.duration <= 0)
+		usage(argv[0]);
+
+	if (weights) {
+		opts.nr_weights = parse_weights(weights, opts.weights,
+						WRR_MAX_TASKS);
+		if (opts.nr_weights < 1)
+			usage(argv[0]);
+	}
+
+	/* the share scenario runs one spinner per weight */
+	if (!strcmp(sc->name, "share") && !weights) {
+		for (i = 0; i < (unsigned int)opts.nr_tasks; i++)
+			opts.weights[i] = 10;
+		opts.nr_weights = opts.nr_tasks;
+	}
+
+	if (opts.policy == SCHED_WRR && get_weight(0) < 0 && errno == ENOSYS)
+		fprintf(stderr, "%s: sched_setweight is not available, "
+			"weights are ignored\n", argv[0]);
+
+	return sc->fn(&opts) ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark scenario: mixed I/O and CPU fairness
+
+	'nr_tasks' CPU spinners and 'nr_tasks' sleepers share one CPU. A sleeper
+	does 200us of work and then sleeps for 1ms, like an interactive or I/O
+	bound task. For every task we report its CPU time and, for sleepers, how
+	late they were woken compared with the requested sleep.
+*/
+
+#include "wrr_bench.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MIXED_WORK_NS	200000
+#define MIXED_SLEEP_US	1000
+
+struct mixed_slot {
+	volatile int ready;
+	uint64_t cpu_ns;
+	uint64_t wakeups;
+	uint64_t wake_sum_ns;
+	uint64_t wake_max_ns;
+};
+
+struct mixed_ctl {
+	volatile int start;
+	volatile int stop;
+	struct mixed_slot slot[2 * WRR_MAX_TASKS];
+};
+
+static void mixed_child(struct bench_opts *opts, struct mixed_ctl *ctl, int i,
+			int sleeper)
+{
+	struct mixed_slot *s = &ctl->slot[i];
+	uint64_t begin, t0, late;
+
+	pin_cpu(opts->cpu);
+	set_policy(0, opts->policy);
+	if (opts->policy == SCHED_WRR)
+		set_weight(0, opts->weights[i % opts->nr_weights]);
+	s->ready = 1;
+
+	while (!ctl->start)
+		;
+	begin = cpu_ns();
+	while (!ctl->stop) {
+		if (!sleeper)
+			continue;
+		spin_for_ns(MIXED_WORK_NS);
+		t0 = now_ns();
+		usleep(MIXED_SLEEP_US);
+		late = now_ns() - t0;
+		late = late > MIXED_SLEEP_US * 1000ULL ?
+			late - MIXED_SLEEP_US * 1000ULL : 0;
+		s->wakeups++;
+		s->wake_sum_ns += late;
+		if (late > s->wake_max_ns)
+			s->wake_max_ns = late;
+	}
+	s->cpu_ns = cpu_ns() - begin;
+	exit(0);
+}
+
+int bench_mixed(struct bench_opts *opts)
+{
+	static const char * const cols[] = {
+		"rep", "task", "kind", "policy", "weight", "cpu_ms", "share",
+		"wakeups", "mean_wake_us", "max_wake_us",
+	};
+	struct mixed_ctl *ctl;
+	pid_t pids[2 * WRR_MAX_TASKS];
+	int n = 2 * opts->nr_tasks;
+	uint64_t total;
+	int rep, i;
+
+	out_begin(opts, "mixed", cols, 10);
+
+	for (rep = 0; rep < opts->reps; rep++) {
+		ctl = shared_alloc(sizeof(*ctl));
+
+		for (i = 0; i < n; i++) {
+			pids[i] = fork();
+			if (pids[i] == 0)
+				mixed_child(opts, ctl, i, i >= opts->nr_tasks);
+		}
+		for (i = 0; i < n; i++)
+			while (!ctl->slot[i].ready)
+				usleep(1000);
+
+		ctl->start = 1;
+		usleep(opts->duration * 1e6);
+		ctl->stop = 1;
+		for (i = 0; i < n; i++)
+			waitpid(pids[i], NULL, 0);
+
+		total = 0;
+		for (i = 0; i < n; i++)
+			total += ctl->slot[i].cpu_ns;
+
+		for (i = 0; i < n; i++) {
+			struct mixed_slot *s = &ctl->slot[i];
+
+			out_row(opts, "%d,%d,%s,%s,%d,%.1f,%.4f,%llu,%.1f,%.1f",
+				rep, i, i >= opts->nr_tasks ? "io" : "cpu",
+				policy_name(opts->policy),
+				opts->weights[i % opts->nr_weights],
+				s->cpu_ns / 1e6,
+				total ? (double)s->cpu_ns / total : 0.0,
+				(unsigned long long)s->wakeups,
+				s->wakeups ? s->wake_sum_ns / 1e3 / s->wakeups : 0.0,
+				s->wake_max_ns / 1e3);
+		}
+
+		shared_free(ctl, sizeof(*ctl));
+	}
+
+	out_end(opts);
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark suite - CSV / JSON result writer
+*/
+
+#include "wrr_bench.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * const *cur_cols;
+static int cur_ncols;
+static int cur_rows;
+
+void out_begin(struct bench_opts *opts, const char *scenario,
+	       const char * const *cols, int ncols)
+{
+	int i;
+
+	cur_cols = cols;
+	cur_ncols = ncols;
+	cur_rows = 0;
+
+	if (opts->format == OUT_JSON) {
+		fprintf(opts->out, "{\"scenario\": \"%s\", \"policy\": \"%s\", \"rows\": [",
+			scenario, policy_name(opts->policy));
+	} else {
+		for (i = 0; i < ncols; i++)
+			fprintf(opts->out, "%s%s", cols[i],
+				i == ncols - 1 ? "\n" : ",");
+	}
+	/* scenarios fork right after this, don't let children inherit the buffer */
+	fflush(opts->out);
+}
+
+/* JSON has no nan or inf literals: those are written as strings */
+static int is_number(const char *s)
+{
+	char *end;
+	double v;
+
+	if (!*s)
+		return 0;
+	v = strtod(s, &end);
+	return *end == '\0' && isfinite(v);
+}
+
+/*
+ * Emit one result row. 'fmt' is a printf format whose output is a comma
+ * separated list with one field per column passed to out_begin().
+ */
+void out_row(struct bench_opts *opts, const char *fmt, ...)
+{
+	char buf[1024];
+	char *field, *save;
+	va_list ap;
+	int i;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	if (opts->format == OUT_CSV) {
+		fprintf(opts->out, "%s\n", buf);
+		fflush(opts->out);
+		return;
+	}
+
+	fprintf(opts->out, "%s\n  {", cur_rows ? "," : "");
+	for (i = 0, field = strtok_r(buf, ",", &save); field && i < cur_ncols;
+	     i++, field = strtok_r(NULL, ",", &save)) {
+		fprintf(opts->out, "%s\"%s\": ", i ? ", " : "", cur_cols[i]);
+		if (is_number(field))
+			fprintf(opts->out, "%s", field);
+		else
+			fprintf(opts->out, "\"%s\"", field);
+	}
+	fprintf(opts->out, "}");
+	fflush(opts->out);
+	cur_rows++;
+}
+
+void out_end(struct bench_opts *opts)
+{
+	if (opts->format == OUT_JSON)
+		fprintf(opts->out, "\n]}\n");
+	fflush(opts->out);
+}
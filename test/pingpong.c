@@ -0,0 +1,112 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark scenario: pipe ping-pong wakeup latency
+
+	Two processes bounce a byte over a pair of pipes while 'nr_load'
+	spinners keep the same CPU busy. Half of each round trip is one
+	wakeup-to-run latency; we report its percentiles.
+*/
+
+#include "wrr_bench.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define PINGPONG_MAX_SAMPLES	100000
+
+static void spinner(struct bench_opts *opts)
+{
+	pin_cpu(opts->cpu);
+	set_policy(0, opts->policy);
+	if (opts->policy == SCHED_WRR)
+		set_weight(0, opts->weights[0]);
+	for (;;)
+		;
+}
+
+int bench_pingpong(struct bench_opts *opts)
+{
+	static const char * const cols[] = {
+		"rep", "policy", "load", "samples", "p50_us", "p90_us", "p99_us",
+		"max_us",
+	};
+	pid_t load[WRR_MAX_TASKS];
+	uint64_t *lat;
+	uint64_t t0, end;
+	int ping[2], pong[2];
+	pid_t peer;
+	char c = 0;
+	int rep, i, n;
+
+	lat = malloc(PINGPONG_MAX_SAMPLES * sizeof(*lat));
+	if (!lat)
+		return -1;
+
+	out_begin(opts, "pingpong", cols, 8);
+
+	for (rep = 0; rep < opts->reps; rep++) {
+		for (i = 0; i < opts->nr_load; i++) {
+			load[i] = fork();
+			if (load[i] == 0)
+				spinner(opts);
+		}
+
+		if (pipe(ping)) {
+			perror("pipe");
+			goto err_load;
+		}
+		if (pipe(pong)) {
+			perror("pipe");
+			close(ping[0]);
+			close(ping[1]);
+			goto err_load;
+		}
+
+		peer = fork();
+		if (peer == 0) {
+			close(ping[1]);
+			close(pong[0]);
+			pin_cpu(opts->cpu);
+			set_policy(0, opts->policy);
+			while (read(ping[0], &c, 1) == 1)
+				if (write(pong[1], &c, 1) != 1)
+					break;
+			exit(0);
+		}
+
+		pin_cpu(opts->cpu);
+		set_policy(0, opts->policy);
+		end = now_ns() + opts->duration * 1e9;
+		for (n = 0; n < PINGPONG_MAX_SAMPLES && now_ns() < end; n++) {
+			t0 = now_ns();
+			if (write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1)
+				break;
+			lat[n] = (now_ns() - t0) / 2;
+		}
+
+		close(ping[1]);
+		close(pong[0]);
+		waitpid(peer, NULL, 0);
+		close(ping[0]);
+		close(pong[1]);
+		reap_children(load, opts->nr_load);
+		pin_cpu(-1);
+
+		qsort(lat, n, sizeof(*lat), cmp_u64);
+		out_row(opts, "%d,%s,%d,%d,%.1f,%.1f,%.1f,%.1f", rep,
+			policy_name(opts->policy), opts->nr_load, n,
+			percentile(lat, n, 50) / 1e3, percentile(lat, n, 90) / 1e3,
+			percentile(lat, n, 99) / 1e3,
+			n ? lat[n - 1] / 1e3 : 0.0);
+	}
+
+	out_end(opts);
+	free(lat);
+	return 0;
+
+err_load:
+	reap_children(load, opts->nr_load);
+	free(lat);
+	return -1;
+}
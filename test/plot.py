@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+#
+# Regenerate the WRR benchmark charts from a run.sh result directory.
+#
+#   plot.py results/<label> [--baseline results/<other>] [-o charts.pdf]
+#
+# Every chart is written as one page of a multi-page PDF. With --baseline
+# the same measurements from an earlier run are drawn next to the current
+# ones so a scheduler change can be judged at a glance.
+
+import argparse
+import csv
+import glob
+import math
+import os
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return list(csv.DictReader(f))
+
+
+def num(row, key):
+    return float(row[key])
+
+
+def mean(xs):
+    return sum(xs) / len(xs) if xs else 0.0
+
+
+def jain(xs):
+    """Jain's fairness index, 1.0 means perfectly equal."""
+    if not xs or not any(xs):
+        return 0.0
+    return sum(xs) ** 2 / (len(xs) * sum(x * x for x in xs))
+
+
+def power_fit(xs, ys):
+    """Least squares fit of y = a * x^b, returns (a, b, r^2)."""
+    lx = [math.log(x) for x in xs]
+    ly = [math.log(y) for y in ys]
+    n = len(lx)
+    mx, my = mean(lx), mean(ly)
+    sxx = sum((x - mx) ** 2 for x in lx)
+    sxy = sum((x - mx) * (y - my) for x, y in zip(lx, ly))
+    syy = sum((y - my) ** 2 for y in ly)
+    if n < 2 or sxx == 0 or syy == 0:
+        return None
+    b = sxy / sxx
+    a = math.exp(my - b * mx)
+    return a, b, sxy * sxy / (sxx * syy)
+
+
+def share_stats(d):
+    """{mix: (weights, expected, achieved)} averaged over repetitions."""
+    out = {}
+    for path in sorted(glob.glob(os.path.join(d, 'share-*.csv'))):
+        rows = load(path)
+        mix = os.path.basename(path)[len('share-'):-len('.csv')]
+        tasks = sorted({int(r['task']) for r in rows})
+        per = [[r for r in rows if int(r['task']) == t] for t in tasks]
+        out[mix] = ([int(p[0]['weight']) for p in per],
+                    [mean([num(r, 'expected') for r in p]) for p in per],
+                    [mean([num(r, 'achieved') for r in p]) for p in per])
+    return out
+
+
+def pingpong_stats(d):
+    """{load: {p50_us, p90_us, p99_us}} averaged over repetitions."""
+    out = {}
+    for path in glob.glob(os.path.join(d, 'pingpong-*.csv')):
+        rows = load(path)
+        if rows:
+            out[int(rows[0]['load'])] = {
+                k: mean([num(r, k) for r in rows])
+                for k in ('p50_us', 'p90_us', 'p99_us')}
+    return out
+
+
+def weight_stats(d):
+    path = os.path.join(d, 'weight.csv')
+    if not os.path.exists(path):
+        return {}
+    out = {}
+    for r in load(path):
+        out.setdefault(int(r['weight']), []).append(num(r, 'wall_ms'))
+    return {w: mean(v) for w, v in out.items()}
+
+
+def summary(d):
+    """One line per metric, also used as the text page of the PDF."""
+    lines = []
+    for mix, (_, exp, ach) in sorted(share_stats(d).items()):
+        err = max(abs(a - e) for a, e in zip(exp, ach))
+        lines.append('share %-12s max error %.4f' % (mix, err))
+    path = os.path.join(d, 'fork.csv')
+    if os.path.exists(path):
+        rows = load(path)
+        lines.append('fork  converged %d/%d, mean %.1f ms, migrations %.0f' % (
+            sum(int(r['converged']) for r in rows), len(rows),
+            mean([num(r, 'converge_ms') for r in rows]),
+            mean([num(r, 'migrations') for r in rows])))
+    for load_, p in sorted(pingpong_stats(d).items()):
+        lines.append('pingpong load %-3d p50 %.1f us p99 %.1f us' % (
+            load_, p['p50_us'], p['p99_us']))
+    path = os.path.join(d, 'mixed.csv')
+    if os.path.exists(path):
+        rows = load(path)
+        cpu = [num(r, 'share') for r in rows if r['kind'] == 'cpu']
+        io = [r for r in rows if r['kind'] == 'io']
+        lines.append('mixed jain(cpu) %.3f, io share %.4f, io wake %.1f us' % (
+            jain(cpu), mean([num(r, 'share') for r in io]),
+            mean([num(r, 'mean_wake_us') for r in io])))
+    fit = weight_stats(d)
+    if len(fit) > 1:
+        f = power_fit(sorted(fit), [fit[w] for w in sorted(fit)])
+        if f:
+            lines.append('weight t = %.0f * x^(%.3f), r^2 %.3f' % f)
+    return lines
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument('results')
+    ap.add_argument('--baseline')
+    ap.add_argument('-o', '--output')
+    ap.add_argument('--text', action='store_true',
+                    help='only print the summary, do not draw')
+    args = ap.parse_args()
+
+    runs = [(os.path.basename(args.results.rstrip('/')), args.results)]
+    if args.baseline:
+        runs.append((os.path.basename(args.baseline.rstrip('/')), args.baseline))
+
+    for label, d in runs:
+        print('[%s]' % label)
+        for line in summary(d):
+            print('  ' + line)
+    if args.text:
+        return 0
+
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+        from matplotlib.backends.backend_pdf import PdfPages
+    except ImportError:
+        sys.stderr.write('matplotlib is required for charts, use --text\n')
+        return 1
+
+    output = args.output or os.path.join(args.results, 'plot.pdf')
+    width = 0.8 / len(runs)
+
+    with PdfPages(output) as pdf:
+        # weight versus runtime, the README curve
+        fig, ax = plt.subplots()
+        for label, d in runs:
+            ws = weight_stats(d)
+            if not ws:
+                continue
+            xs = sorted(ws)
+            ax.plot(xs, [ws[w] for w in xs], 'o', label=label)
+            f = power_fit(xs, [ws[w] for w in xs])
+            if f:
+                ax.plot(xs, [f[0] * x ** f[1] for x in xs], '-',
+                        label='%s: t = %.0f x^%.3f, r^2 %.3f' % ((label,) + f))
+        ax.set_xlabel('weight')
+        ax.set_ylabel('runtime (ms)')
+        ax.set_title('trial division runtime per weight')
+        ax.legend()
+        pdf.savefig(fig)
+        plt.close(fig)
+
+        # share accuracy, one page per weight mix
+        base = share_stats(runs[0][1])
+        for mix in sorted(base):
+            fig, ax = plt.subplots()
+            weights, exp, _ = base[mix]
+            xs = range(len(weights))
+            ax.bar([x - 0.4 for x in xs], exp, width, align='edge',
+                   label='expected', color='lightgray')
+            for i, (label, d) in enumerate(runs):
+                st = share_stats(d).get(mix)
+                if st:
+                    ax.bar([x - 0.4 + width * (i + 1) / 2 for x in xs],
+                           st[2], width / 2, align='edge', label=label)
+            ax.set_xticks(list(xs))
+            ax.set_xticklabels(['w=%d' % w for w in weights])
+            ax.set_ylabel('CPU share')
+            ax.set_title('share accuracy, weights %s' % mix.replace('_', ','))
+            ax.legend()
+            pdf.savefig(fig)
+            plt.close(fig)
+
+        # wakeup latency against background load
+        fig, ax = plt.subplots()
+        for label, d in runs:
+            pp = pingpong_stats(d)
+            loads = sorted(pp)
+            for key, style in (('p50_us', 'o-'), ('p99_us', 's--')):
+                ax.plot(loads, [pp[l][key] for l in loads], style,
+                        label='%s %s' % (label, key[:3]))
+        ax.set_xlabel('background spinners')
+        ax.set_ylabel('wakeup latency (us)')
+        ax.set_title('pipe ping-pong')
+        ax.legend()
+        pdf.savefig(fig)
+        plt.close(fig)
+
+        # text summary of fork storm and mixed fairness
+        fig = plt.figure()
+        y = 0.95
+        for label, d in runs:
+            fig.text(0.05, y, '[%s]' % label, family='monospace')
+            y -= 0.05
+            for line in summary(d):
+                fig.text(0.08, y, line, family='monospace', fontsize=8)
+                y -= 0.04
+        pdf.savefig(fig)
+        plt.close(fig)
+
+    print('charts in %s' % output)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Run every WRR benchmark scenario and store the results under $1.
+# Extra arguments are passed to each scenario (e.g. -d 10 -r 5).
+#
+# Weights above the current one can only be set by root, so run this as
+# root on the target to get meaningful share and weight results.
+
+set -e
+
+out=${1:?usage: run.sh <result-dir> [wrr_bench options]}
+shift
+bench=$(dirname "$0")/wrr_bench
+ncpu=$(getconf _NPROCESSORS_ONLN)
+
+mkdir -p "$out"
+uname -a > "$out/uname.txt"
+
+for mix in 10,10,10,10 1,5,10,20 1,2,4,8,16 5,5,20; do
+	$bench share -w $mix "$@" -o "$out/share-$(echo $mix | tr , _).csv"
+done
+$bench fork -n $((ncpu * 4)) -d 10 "$@" -o "$out/fork.csv"
+for load in 0 1 4; do
+	$bench pingpong -l $load "$@" -o "$out/pingpong-$load.csv"
+done
+$bench mixed -n 4 -w 10 "$@" -o "$out/mixed.csv"
+$bench weight -l 16 -r 1 -w 1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20 \
+	"$@" -o "$out/weight.csv"
+
+echo "results in $out"
@@ -0,0 +1,109 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark scenario: N spinners sharing one CPU
+
+	Every spinner is pinned to the same CPU with its own weight. After
+	'duration' seconds the CPU time each one received is compared against
+	weight / total_weight, which is what WRR promises.
+*/
+
+#include "wrr_bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+struct share_slot {
+	volatile int ready;
+	int weight;			/* weight reported by sched_getweight */
+	uint64_t cpu_ns;
+};
+
+struct share_ctl {
+	volatile int start;
+	volatile int stop;
+	struct share_slot slot[WRR_MAX_TASKS];
+};
+
+static void share_child(struct bench_opts *opts, struct share_ctl *ctl, int i)
+{
+	struct share_slot *s = &ctl->slot[i];
+	uint64_t begin;
+
+	pin_cpu(opts->cpu);
+	set_policy(0, opts->policy);
+	if (opts->policy == SCHED_WRR && set_weight(0, opts->weights[i]) == 0)
+		s->weight = get_weight(0);
+	s->ready = 1;
+
+	while (!ctl->start)
+		;
+	begin = cpu_ns();
+	while (!ctl->stop)
+		;
+	s->cpu_ns = cpu_ns() - begin;
+	exit(0);
+}
+
+int bench_share(struct bench_opts *opts)
+{
+	static const char * const cols[] = {
+		"rep", "task", "policy", "weight", "expected", "achieved", "error",
+	};
+	struct share_ctl *ctl;
+	pid_t pids[WRR_MAX_TASKS];
+	uint64_t total;
+	int total_weight;
+	int rep, i, n;
+
+	n = opts->nr_weights;
+	out_begin(opts, "share", cols, 7);
+
+	for (rep = 0; rep < opts->reps; rep++) {
+		ctl = shared_alloc(sizeof(*ctl));
+
+		for (i = 0; i < n; i++) {
+			pids[i] = fork();
+			if (pids[i] == 0)
+				share_child(opts, ctl, i);
+		}
+		for (i = 0; i < n; i++)
+			while (!ctl->slot[i].ready)
+				usleep(1000);
+
+		ctl->start = 1;
+		usleep(opts->duration * 1e6);
+		ctl->stop = 1;
+		for (i = 0; i < n; i++)
+			waitpid(pids[i], NULL, 0);
+
+		total = 0;
+		total_weight = 0;
+		for (i = 0; i < n; i++) {
+			total += ctl->slot[i].cpu_ns;
+			total_weight += ctl->slot[i].weight;
+		}
+
+		for (i = 0; i < n; i++) {
+			double expected, achieved;
+
+			/* without working weights every task is entitled to the same share */
+			if (opts->policy == SCHED_WRR && total_weight > 0 &&
+			    ctl->slot[i].weight > 0)
+				expected = (double)ctl->slot[i].weight / total_weight;
+			else
+				expected = 1.0 / n;
+			achieved = total ? (double)ctl->slot[i].cpu_ns / total : 0;
+
+			out_row(opts, "%d,%d,%s,%d,%.4f,%.4f,%.4f", rep, i,
+				policy_name(opts->policy), opts->weights[i],
+				expected, achieved, fabs(achieved - expected));
+		}
+
+		shared_free(ctl, sizeof(*ctl));
+	}
+
+	out_end(opts);
+	return 0;
+}
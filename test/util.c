@@ -0,0 +1,171 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark suite - timing, policy and process helpers
+*/
+
+#include "wrr_bench.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void spin_for_ns(uint64_t ns)
+{
+	uint64_t end = cpu_ns() + ns;
+
+	while (cpu_ns() < end)
+		;
+}
+
+int set_policy(pid_t pid, int policy)
+{
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	if (policy == SCHED_RR || policy == SCHED_FIFO)
+		param.sched_priority = 1;
+	return sched_setscheduler(pid, policy, &param);
+}
+
+int set_weight(pid_t pid, int weight)
+{
+#ifdef __NR_sched_setweight
+	return syscall(__NR_sched_setweight, pid, weight);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+int get_weight(pid_t pid)
+{
+#ifdef __NR_sched_getweight
+	return syscall(__NR_sched_getweight, pid);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+int pin_cpu(int cpu)
+{
+	cpu_set_t set;
+	int i;
+
+	CPU_ZERO(&set);
+	if (cpu < 0) {
+		/* widen the mask back to every CPU */
+		for (i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &set);
+	} else {
+		CPU_SET(cpu, &set);
+	}
+	return sched_setaffinity(0, sizeof(set), &set);
+}
+
+void *shared_alloc(size_t size)
+{
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	memset(p, 0, size);
+	return p;
+}
+
+void shared_free(void *p, size_t size)
+{
+	munmap(p, size);
+}
+
+void reap_children(pid_t *pids, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (pids[i] > 0)
+			kill(pids[i], SIGKILL);
+	for (i = 0; i < n; i++)
+		if (pids[i] > 0)
+			waitpid(pids[i], NULL, 0);
+}
+
+const char *policy_name(int policy)
+{
+	switch (policy) {
+	case SCHED_WRR:
+		return "wrr";
+	case SCHED_NORMAL:
+		return "normal";
+	case SCHED_RR:
+		return "rr";
+	case SCHED_FIFO:
+		return "fifo";
+	}
+	return "unknown";
+}
+
+/* "1,5,10" -> {1, 5, 10}; returns the number of weights parsed or -1 */
+int parse_weights(const char *s, int *weights, int max)
+{
+	int n = 0;
+	char *end;
+	long w;
+
+	while (*s) {
+		if (n == max)
+			return -1;
+		w = strtol(s, &end, 10);
+		if (end == s || w < 1 || w > WRR_MAX_WEIGHT)
+			return -1;
+		weights[n++] = w;
+		s = end;
+		if (*s == ',')
+			s++;
+		else if (*s)
+			return -1;
+	}
+	return n;
+}
+
+int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+uint64_t percentile(uint64_t *sorted, int n, double pct)
+{
+	int idx;
+
+	if (n == 0)
+		return 0;
+	idx = (int)(pct / 100.0 * (n - 1) + 0.5);
+	return sorted[idx];
+}
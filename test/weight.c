@@ -0,0 +1,84 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark scenario: weight versus runtime
+
+	This is the experiment behind plot.pdf. 'nr_load' spinners keep the
+	CPU busy at the default weight while a trial division of 1874919423
+	(= 3 * 13 * 48074857) runs at each weight in turn. The wall time of
+	the factorisation is recorded per weight.
+*/
+
+#include "wrr_bench.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define TRIAL_NUMBER	1874919423UL
+#define DEFAULT_WEIGHT	10
+
+static unsigned long trial_division(unsigned long n)
+{
+	unsigned long d, factors = 0;
+
+	for (d = 2; n > 1; d++) {
+		while (n % d == 0) {
+			n /= d;
+			factors++;
+		}
+	}
+	return factors;
+}
+
+static void load_child(struct bench_opts *opts)
+{
+	pin_cpu(opts->cpu);
+	set_policy(0, opts->policy);
+	if (opts->policy == SCHED_WRR)
+		set_weight(0, DEFAULT_WEIGHT);
+	for (;;)
+		;
+}
+
+int bench_weight(struct bench_opts *opts)
+{
+	static const char * const cols[] = {
+		"rep", "policy", "weight", "load", "wall_ms", "cpu_ms",
+	};
+	pid_t load[WRR_MAX_TASKS];
+	int rep, i, w;
+
+	out_begin(opts, "weight", cols, 6);
+
+	for (i = 0; i < opts->nr_load; i++) {
+		load[i] = fork();
+		if (load[i] == 0)
+			load_child(opts);
+	}
+
+	pin_cpu(opts->cpu);
+	set_policy(0, opts->policy);
+
+	for (rep = 0; rep < opts->reps; rep++) {
+		for (w = 0; w < opts->nr_weights; w++) {
+			uint64_t wall, cpu;
+
+			if (opts->policy == SCHED_WRR)
+				set_weight(0, opts->weights[w]);
+			wall = now_ns();
+			cpu = cpu_ns();
+			trial_division(TRIAL_NUMBER);
+			wall = now_ns() - wall;
+			cpu = cpu_ns() - cpu;
+
+			out_row(opts, "%d,%s,%d,%d,%.1f,%.1f", rep,
+				policy_name(opts->policy), opts->weights[w],
+				opts->nr_load, wall / 1e6, cpu / 1e6);
+		}
+	}
+
+	reap_children(load, opts->nr_load);
+	pin_cpu(-1);
+	out_end(opts);
+	return 0;
+}
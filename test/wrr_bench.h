@@ -0,0 +1,91 @@
+/*
+	Operating System 2016 project 3: Weighted Round-Robin scheduler
+	Benchmark suite - common helpers shared by every scenario
+*/
+
+#ifndef _WRR_BENCH_H
+#define _WRR_BENCH_H
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifndef SCHED_NORMAL
+#define SCHED_NORMAL 0
+#endif
+#ifndef SCHED_WRR
+#define SCHED_WRR 6
+#endif
+
+/*
+ * sched_setweight / sched_getweight are only wired into the ARM syscall
+ * table (arch/arm/kernel/calls.S). Other architectures can pass the numbers
+ * with -D__NR_sched_setweight=... once they are added there; until then the
+ * weight calls fail with ENOSYS and the scenarios report it.
+ */
+#ifndef __NR_sched_setweight
+#if defined(__arm__)
+#define __NR_sched_setweight 384
+#define __NR_sched_getweight 385
+#endif
+#endif
+
+#define WRR_MAX_TASKS	256
+#define WRR_MAX_WEIGHT	20
+
+enum out_format {
+	OUT_CSV,
+	OUT_JSON,
+};
+
+struct bench_opts {
+	int policy;			/* SCHED_WRR, SCHED_NORMAL or SCHED_RR */
+	int cpu;			/* cpu to pin to, -1 for no pinning */
+	double duration;		/* seconds per measurement */
+	int nr_tasks;
+	int nr_load;			/* background spinners */
+	int reps;
+	int weights[WRR_MAX_TASKS];
+	int nr_weights;
+	enum out_format format;
+	FILE *out;
+};
+
+struct bench_scenario {
+	const char *name;
+	const char *summary;
+	int (*fn)(struct bench_opts *opts);
+};
+
+/* util.c */
+uint64_t now_ns(void);
+uint64_t cpu_ns(void);
+void spin_for_ns(uint64_t ns);
+int set_policy(pid_t pid, int policy);
+int set_weight(pid_t pid, int weight);
+int get_weight(pid_t pid);
+int pin_cpu(int cpu);
+void *shared_alloc(size_t size);
+void shared_free(void *p, size_t size);
+void reap_children(pid_t *pids, int n);
+const char *policy_name(int policy);
+int parse_weights(const char *s, int *weights, int max);
+int cmp_u64(const void *a, const void *b);
+uint64_t percentile(uint64_t *sorted, int n, double pct);
+
+/* output.c */
+void out_begin(struct bench_opts *opts, const char *scenario,
+	       const char * const *cols, int ncols);
+void out_row(struct bench_opts *opts, const char *fmt, ...);
+void out_end(struct bench_opts *opts);
+
+/* scenarios */
+int bench_share(struct bench_opts *opts);
+int bench_fork(struct bench_opts *opts);
+int bench_pingpong(struct bench_opts *opts);
+int bench_mixed(struct bench_opts *opts);
+int bench_weight(struct bench_opts *opts);
+
+#endif